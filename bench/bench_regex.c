@@ -0,0 +1,172 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Compares regexec() with REG_ICASE, as query.c used it for every
+// search word, against the lazy DFA on the cmd, user and pid of
+// a synthetic proc table.
+//
+// Usage: bench_regex [nprocs]
+
+#include "config.h"
+
+#include <limits.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dfa.h"
+
+#define REPS 10
+
+static const char *names[] = {
+        "php-fpm", "postgres", "nginx: worker", "kworker/u16:3", "bash",
+        "systemd-journald", "sshd", "java", "chrome_crashpad", "node",
+        "containerd-shim", "python3", "redis-server", "cron", "rsyslogd",
+};
+
+static const char *users[] = {
+        "root", "www-data", "postgres", "nobody", "app",
+};
+
+#define LEN(a) (sizeof(a)/sizeof(*(a)))
+
+typedef struct {
+        const char *cmd, *user;
+        char pid[12];
+} row;
+
+static double
+now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Skewed towards the first few names, like a real worker node.
+static size_t
+pick(size_t n)
+{
+        double r = (double)rand() / RAND_MAX;
+        return (size_t)(n * r * r * r);
+}
+
+static size_t
+run_libc(const row *rows,
+         size_t n,
+         const regex_t *re)
+{
+        size_t hits = 0;
+        for (size_t i = 0; i < n; ++i) {
+                hits += regexec(re, rows[i].cmd, 0, NULL, 0) == 0
+                        || regexec(re, rows[i].user, 0, NULL, 0) == 0
+                        || regexec(re, rows[i].pid, 0, NULL, 0) == 0;
+        }
+        return hits;
+}
+
+static size_t
+run_dfa(const row *rows,
+        size_t n,
+        dfa *d)
+{
+        size_t hits = 0;
+        for (size_t i = 0; i < n; ++i) {
+                hits += dfa_match(d, rows[i].cmd)
+                        || dfa_match(d, rows[i].user)
+                        || dfa_match(d, rows[i].pid);
+        }
+        return hits;
+}
+
+int
+main(int argc, char **argv)
+{
+        size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+        // Pids are ints, like in /proc
+        if (n > INT_MAX) {
+                fprintf(stderr, "at most %d procs\n", INT_MAX);
+                return 1;
+        }
+        const char *patterns[] = {
+                "nginx", "POSTGRES", "nonexistent", "^pg_|^postgres", "worker.*[0-9]+",
+                "d$", "(php|node|python)[0-9]*", "[[:digit:]]{3}",
+        };
+
+        srand(42);
+
+        row *rows = calloc(n, sizeof(*rows));
+        if (!rows) return 1;
+        for (size_t i = 0; i < n; ++i) {
+                rows[i].cmd = names[pick(LEN(names))];
+                rows[i].user = users[pick(LEN(users))];
+                snprintf(rows[i].pid, sizeof(rows[i].pid), "%d", (int)(i + 1));
+        }
+
+        printf("procs: %zu\n\n", n);
+        printf("%-26s %8s %12s %12s %8s\n", "pattern", "hits", "libc(us)", "dfa(us)", "speedup");
+
+        for (size_t i = 0; i < LEN(patterns); ++i) {
+                regex_t re;
+                if (regcomp(&re, patterns[i], REG_ICASE | REG_NOSUB | REG_EXTENDED)) {
+                        fprintf(stderr, "bad pattern `%s`\n", patterns[i]);
+                        return 1;
+                }
+
+                // A new DFA per rep, so building its states is
+                // part of the time like it is for each keystroke.
+                double best_libc = 1e9, best_dfa = 1e9;
+                size_t hits_libc = 0, hits_dfa = 0;
+                int fallback = 0;
+                for (int r = 0; r < REPS; ++r) {
+                        double t0 = now();
+                        hits_libc = run_libc(rows, n, &re);
+                        double t = now() - t0;
+                        if (t < best_libc) best_libc = t;
+
+                        t0 = now();
+                        dfa *d = dfa_compile(patterns[i], strlen(patterns[i]), 1);
+                        if (!d) {
+                                fallback = 1;
+                                break;
+                        }
+                        hits_dfa = run_dfa(rows, n, d);
+                        dfa_free(d);
+                        t = now() - t0;
+                        if (t < best_dfa) best_dfa = t;
+                }
+
+                if (fallback) {
+                        printf("%-26s %8zu %12.1f %12s %8s\n", patterns[i], hits_libc,
+                               best_libc * 1e6, "libc", "-");
+                } else if (hits_libc != hits_dfa) {
+                        fprintf(stderr, "mismatch for `%s`: %zu vs %zu\n", patterns[i], hits_libc, hits_dfa);
+                        return 1;
+                } else {
+                        printf("%-26s %8zu %12.1f %12.1f %7.1fx\n", patterns[i], hits_libc,
+                               best_libc * 1e6, best_dfa * 1e6, best_libc / best_dfa);
+                }
+                regfree(&re);
+        }
+
+        free(rows);
+        return 0;
+}
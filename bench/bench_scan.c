@@ -0,0 +1,122 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Times a full scan of a proc tree with each reader, and filtering the result
+// with queries of increasing length, as typed.
+//
+// Usage: bench_scan [PROC_ROOT]
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "proc.h"
+#include "query.h"
+
+#define REPS 5
+
+static double
+now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+free_procs(proc_ptr_array *procs)
+{
+        for (size_t i = 0; i < procs->len; ++i) {
+                proc_free(procs->data[i]);
+        }
+        procs->len = 0;
+}
+
+static size_t
+filter(const proc_ptr_array *procs,
+       const char *input,
+       size_t len)
+{
+        size_t hits = 0;
+        query *q = query_compile(input, len);
+        for (size_t i = 0; q && i < procs->len; ++i) {
+                hits += query_match(q, procs->data[i]);
+        }
+        query_free(q);
+        return hits;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+        const char *root = argc > 1 ? argv[1] : "/proc";
+        const char *typed[] = {"php-fpm", "user:root cmd:~^pg", "rss:>512M !cmd:java"};
+        proc_ptr_array procs = {0};
+
+        if (proc_root_open(root) == -1) {
+                perror(root);
+                return 1;
+        }
+
+        double best;
+        const fileio_backend readers[] = {FIO_SYNC, FIO_THREADS, FIO_URING};
+        for (size_t k = 0; k < sizeof(readers)/sizeof(*readers); ++k) {
+                proc_set_reader(readers[k]);
+
+                // The first scan warms the dentry and page caches.
+                best = 1e9;
+                for (int r = 0; r < REPS + 1; ++r) {
+                        free_procs(&procs);
+                        double t0 = now();
+                        proc_scan(&procs, PF_DEFAULT);
+                        double t = now() - t0;
+                        if (r > 0 && t < best) best = t;
+                }
+
+                printf("scan reader=%s procs=%zu total_ms=%.3f per_proc_us=%.3f\n",
+                       fileio_backend_name(readers[k]), procs.len, best * 1e3,
+                       procs.len ? best * 1e6 / procs.len : 0.0);
+        }
+
+        for (size_t i = 0; i < sizeof(typed)/sizeof(*typed); ++i) {
+                // Every prefix, like the TUI filters on every keystroke.
+                size_t n = strlen(typed[i]);
+                for (size_t len = 1; len <= n; ++len) {
+                        size_t hits = 0;
+                        best = 1e9;
+                        for (int r = 0; r < REPS; ++r) {
+                                double t0 = now();
+                                hits = filter(&procs, typed[i], len);
+                                double t = now() - t0;
+                                if (t < best) best = t;
+                        }
+                        printf("filter query=\"%.*s\" len=%zu hits=%zu ms=%.3f\n",
+                               (int)len, typed[i], len, hits, best * 1e3);
+                }
+        }
+
+        free_procs(&procs);
+        dyn_array_free(procs);
+        proc_cleanup();
+        return 0;
+}
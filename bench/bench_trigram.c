@@ -0,0 +1,161 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Compares a linear query_match() scan against narrowing with
+// the trigram index first, on a synthetic proc table.
+//
+// Usage: bench_trigram [nprocs]
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "intern.h"
+#include "proc.h"
+#include "query.h"
+#include "trigram.h"
+
+#define REPS 20
+
+static const char *names[] = {
+        "php-fpm", "postgres", "nginx: worker", "kworker/u16:3", "bash",
+        "systemd-journald", "sshd", "java", "chrome_crashpad", "node",
+        "containerd-shim", "python3", "redis-server", "cron", "rsyslogd",
+};
+
+static const char *users[] = {
+        "root", "www-data", "postgres", "nobody", "app",
+};
+
+#define LEN(a) (sizeof(a)/sizeof(*(a)))
+
+static double
+now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Skewed towards the first few names, like a real worker node.
+static size_t
+pick(size_t n)
+{
+        double r = (double)rand() / RAND_MAX;
+        return (size_t)(n * r * r * r);
+}
+
+static size_t
+run_linear(const proc_ptr_array *procs,
+           const query *q)
+{
+        size_t hits = 0;
+        for (size_t i = 0; i < procs->len; ++i) {
+                hits += query_match(q, procs->data[i]);
+        }
+        return hits;
+}
+
+static size_t
+run_index(const proc_ptr_array *procs,
+          const trigram_index *idx,
+          const query *q,
+          u32_array *cands)
+{
+        const char *lit = query_literal(q);
+        if (!lit || !trigram_candidates(idx, lit, cands)) {
+                return run_linear(procs, q);
+        }
+        size_t hits = 0;
+        for (size_t i = 0; i < cands->len; ++i) {
+                hits += query_match(q, procs->data[cands->data[i]]);
+        }
+        return hits;
+}
+
+int
+main(int argc, char **argv)
+{
+        size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+        const char *queries[] = {
+                "nginx", "postgres", "crashpad", "user:www cmd:fpm", "nonexistent", "sh",
+        };
+
+        srand(42);
+
+        proc_ptr_array procs = {0};
+        for (size_t i = 0; i < n; ++i) {
+                proc *p = calloc(1, sizeof(*p));
+                char cmd[64];
+                snprintf(cmd, sizeof(cmd), "%s", names[pick(LEN(names))]);
+                p->pid = (pid_t)(i + 1);
+                snprintf(p->pidstr, sizeof(p->pidstr), "%d", p->pid);
+                if (!(p->cmd = intern(cmd, strlen(cmd)))) return 1;
+                p->user = users[pick(LEN(users))];
+                p->loaded = PF_STATUS | PF_USER;
+                dyn_array_append(procs, p);
+        }
+
+        double t0 = now();
+        trigram_index *idx = trigram_build(&procs);
+        double build = now() - t0;
+
+        printf("procs: %zu\n", n);
+        printf("index build: %.3f ms\n\n", build * 1e3);
+        printf("%-20s %8s %12s %12s %8s\n", "query", "hits", "linear(us)", "index(us)", "speedup");
+
+        u32_array cands = {0};
+        for (size_t i = 0; i < LEN(queries); ++i) {
+                query *q = query_compile(queries[i], strlen(queries[i]));
+                double best_lin = 1e9, best_idx = 1e9;
+                size_t hits_lin = 0, hits_idx = 0;
+
+                for (int r = 0; r < REPS; ++r) {
+                        t0 = now();
+                        hits_lin = run_linear(&procs, q);
+                        double t = now() - t0;
+                        if (t < best_lin) best_lin = t;
+
+                        t0 = now();
+                        hits_idx = run_index(&procs, idx, q, &cands);
+                        t = now() - t0;
+                        if (t < best_idx) best_idx = t;
+                }
+
+                if (hits_lin != hits_idx) {
+                        fprintf(stderr, "mismatch for `%s`: %zu vs %zu\n", queries[i], hits_lin, hits_idx);
+                        return 1;
+                }
+
+                printf("%-20s %8zu %12.1f %12.1f %7.1fx\n", queries[i], hits_lin,
+                       best_lin * 1e6, best_idx * 1e6, best_lin / best_idx);
+                query_free(q);
+        }
+
+        dyn_array_free(cands);
+        trigram_free(idx);
+        for (size_t i = 0; i < procs.len; ++i) {
+                proc_free(procs.data[i]);
+        }
+        dyn_array_free(procs);
+        return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Writes a fake /proc tree for benchmarking, with `nprocs`
+// processes whose names follow a skewed distribution.
+//
+// Usage: gen_proc DIR NPROCS
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const struct {
+        const char *name;
+        const char *args;
+} cmds[] = {
+        {"php-fpm",          "php-fpm: pool www"},
+        {"postgres",         "postgres: writer process"},
+        {"nginx",            "nginx: worker process"},
+        {"kworker/u16:3",    ""},
+        {"bash",             "-bash"},
+        {"java",             "java -Xmx8g -jar /opt/app/service.jar --port 8080"},
+        {"chrome_crashpad",  "/opt/google/chrome/chrome_crashpad_handler --monitor-self"},
+        {"node",             "node /srv/app/server.js"},
+        {"containerd-shim",  "/usr/bin/containerd-shim-runc-v2 -namespace k8s.io"},
+        {"python3",          "python3 -m worker --queue default"},
+        {"redis-server",     "redis-server *:6379"},
+        {"sshd",             "sshd: operator [priv]"},
+        {"systemd-journald", "/usr/lib/systemd/systemd-journald"},
+        {"cron",             "/usr/sbin/cron -f"},
+        {"rsyslogd",         "/usr/sbin/rsyslogd -n"},
+        {"kthreadd",         ""},
+};
+
+static const unsigned uids[] = {0, 0, 33, 999, 1000, 65534};
+
+#define LEN(a) (sizeof(a)/sizeof(*(a)))
+
+// Deterministic so every run generates the same tree.
+static unsigned long long rng = 0x9e3779b97f4a7c15ull;
+
+static double
+rnd(void)
+{
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return (double)(rng >> 11) / (double)(1ull << 53);
+}
+
+static size_t
+pick(size_t n)
+{
+        double r = rnd();
+        return (size_t)(n * r * r * r);
+}
+
+static void
+write_file(const char *path,
+           const char *data,
+           size_t len)
+{
+        FILE *f = fopen(path, "w");
+        if (!f) {
+                fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                exit(1);
+        }
+        fwrite(data, 1, len, f);
+        fclose(f);
+}
+
+static void
+write_proc(const char *root,
+           unsigned pid)
+{
+        char path[4096], buf[4096];
+        size_t c = pick(LEN(cmds));
+        unsigned uid = uids[pick(LEN(uids))];
+        unsigned ppid = pid > 1 ? 1 + (unsigned)(rnd() * (pid - 1)) : 0;
+        unsigned long rss = cmds[c].args[0] ? 1024 + (unsigned long)(rnd() * rnd() * 8 * 1024 * 1024) : 0;
+        unsigned long long start = 100 + (unsigned long long)pid * 3;
+        unsigned long long utime = (unsigned long long)(rnd() * rnd() * 100000);
+
+        snprintf(path, sizeof(path), "%s/%u", root, pid);
+        mkdir(path, 0755);
+
+        int n = snprintf(buf, sizeof(buf),
+                "Name:\t%s\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t%u\nNgid:\t0\n"
+                "Pid:\t%u\nPPid:\t%u\nTracerPid:\t0\nUid:\t%u\t%u\t%u\t%u\n"
+                "Gid:\t%u\t%u\t%u\t%u\nFDSize:\t64\nGroups:\t\nNStgid:\t%u\nNSpid:\t%u\n"
+                "NSpgid:\t%u\nNSsid:\t%u\nVmPeak:\t%8lu kB\nVmSize:\t%8lu kB\nVmLck:\t       0 kB\n"
+                "VmPin:\t       0 kB\nVmHWM:\t%8lu kB\nVmRSS:\t%8lu kB\nRssAnon:\t%8lu kB\n"
+                "RssFile:\t       0 kB\nRssShmem:\t       0 kB\nVmData:\t%8lu kB\nVmStk:\t     132 kB\n"
+                "VmExe:\t      20 kB\nVmLib:\t    1528 kB\nVmPTE:\t      52 kB\nVmSwap:\t       0 kB\n"
+                "HugetlbPages:\t       0 kB\nCoreDumping:\t0\nTHP_enabled:\t1\nThreads:\t1\n"
+                "SigQ:\t0/63431\nSigPnd:\t0000000000000000\nShdPnd:\t0000000000000000\n"
+                "SigBlk:\t0000000000000000\nSigIgn:\t0000000000001000\nSigCgt:\t0000000000000000\n"
+                "CapInh:\t0000000000000000\nCapPrm:\t0000000000000000\nCapEff:\t0000000000000000\n"
+                "CapBnd:\t000001ffffffffff\nCapAmb:\t0000000000000000\nNoNewPrivs:\t0\nSeccomp:\t0\n"
+                "Speculation_Store_Bypass:\tthread vulnerable\nCpus_allowed:\tff\n"
+                "Cpus_allowed_list:\t0-7\nMems_allowed:\t1\nMems_allowed_list:\t0\n"
+                "voluntary_ctxt_switches:\t%llu\nnonvoluntary_ctxt_switches:\t0\n",
+                cmds[c].name, pid, pid, ppid, uid, uid, uid, uid, uid, uid, uid, uid,
+                pid, pid, pid, pid, rss * 2, rss * 2, rss, rss, rss, rss, utime);
+        snprintf(path, sizeof(path), "%s/%u/status", root, pid);
+        write_file(path, buf, (size_t)n);
+
+        n = snprintf(buf, sizeof(buf),
+                "%u (%s) S %u %u %u 0 -1 4194560 100 0 0 0 %llu %llu 0 0 20 0 1 0 %llu "
+                "%lu %lu 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 0 0 0 0 0 0 "
+                "0 0 0 0 0 0 0\n",
+                pid, cmds[c].name, ppid, pid, pid, utime, utime / 4, start,
+                rss * 2048, rss / 4);
+        snprintf(path, sizeof(path), "%s/%u/stat", root, pid);
+        write_file(path, buf, (size_t)n);
+
+        // cmdline is NUL separated.
+        n = snprintf(buf, sizeof(buf), "%s", cmds[c].args);
+        for (int i = 0; i < n; ++i) {
+                if (buf[i] == ' ') buf[i] = '\0';
+        }
+        snprintf(path, sizeof(path), "%s/%u/cmdline", root, pid);
+        write_file(path, buf, n ? (size_t)n + 1 : 0);
+
+        n = snprintf(buf, sizeof(buf), "0::/system.slice/%s.service\n", cmds[c].name);
+        snprintf(path, sizeof(path), "%s/%u/cgroup", root, pid);
+        write_file(path, buf, (size_t)n);
+}
+
+int
+main(int argc,
+     char **argv)
+{
+        if (argc != 3) {
+                fprintf(stderr, "usage: %s DIR NPROCS\n", argv[0]);
+                return 1;
+        }
+
+        const char *root = argv[1];
+        unsigned n = (unsigned)strtoul(argv[2], NULL, 10);
+        char path[4096];
+
+        if (mkdir(root, 0755) == -1 && errno != EEXIST) {
+                fprintf(stderr, "%s: %s\n", root, strerror(errno));
+                return 1;
+        }
+
+        for (unsigned pid = 1; pid <= n; ++pid) {
+                write_proc(root, pid);
+        }
+
+        const char *hdr = "  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode\n";
+        snprintf(path, sizeof(path), "%s/net", root);
+        mkdir(path, 0755);
+        const char *tables[] = {"tcp", "tcp6", "udp", "udp6"};
+        for (size_t i = 0; i < LEN(tables); ++i) {
+                snprintf(path, sizeof(path), "%s/net/%s", root, tables[i]);
+                write_file(path, hdr, strlen(hdr));
+        }
+
+        snprintf(path, sizeof(path), "%s/uptime", root);
+        write_file(path, "360000.00 2800000.00\n", 21);
+
+        return 0;
+}
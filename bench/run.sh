@@ -0,0 +1,44 @@
+#!/bin/sh
+# Runs the end-to-end benchmarks against generated /proc trees.
+# Called by `make bench` from the build directory.
+#
+# BENCH_SIZES  process counts to generate (default: 10000 100000)
+# BENCH_DIR    where the fixture trees are kept (default: bench-fixtures)
+
+set -e
+
+here=$(dirname "$0")
+sizes=${BENCH_SIZES:-10000 100000}
+dir=${BENCH_DIR:-bench-fixtures}
+reps=5
+
+now_ns() {
+        date +%s%N
+}
+
+mkdir -p "$dir"
+
+for n in $sizes; do
+        root="$dir/proc-$n"
+        if [ ! -f "$root/uptime" ]; then
+                echo "generating $root"
+                rm -rf "$root"
+                ./gen_proc "$root" "$n"
+        fi
+
+        echo "== $n procs"
+        ./bench_scan "$root"
+
+        best=
+        i=0
+        while [ $i -lt $reps ]; do
+                t0=$(now_ns)
+                ./xkillr --proc-root "$root" --list > /dev/null
+                t=$(( $(now_ns) - t0 ))
+                if [ -z "$best" ] || [ $t -lt $best ]; then best=$t; fi
+                i=$((i + 1))
+        done
+        TERM=xterm LINES=50 COLUMNS=120 ./xkillr --proc-root "$root" --replay "$here/typing.keys" 2>&1
+
+        echo "list ms=$((best / 1000000)).$(printf '%03d' $(( (best / 1000) % 1000 )))"
+done
@@ -0,0 +1,232 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cgroup.h"
+
+static int cgroup_dirfd = -1;
+
+int
+cgroup_root_open(const char *path)
+{
+        int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+                return -1;
+        }
+        if (cgroup_dirfd != -1) {
+                close(cgroup_dirfd);
+        }
+        cgroup_dirfd = fd;
+        return 0;
+}
+
+static int
+by_cgroup(const void *a,
+          const void *b)
+{
+        const proc *pa = *(const proc **)a, *pb = *(const proc **)b;
+        // Interned, so comparing pointers is enough to group them.
+        if (pa->cgroup != pb->cgroup) return (uintptr_t)pa->cgroup < (uintptr_t)pb->cgroup ? -1 : 1;
+        return pa->pid < pb->pid ? -1 : pa->pid > pb->pid;
+}
+
+static int
+by_rss(const void *a,
+       const void *b)
+{
+        const cgroup_group *ga = a, *gb = b;
+        if (ga->rss != gb->rss) return ga->rss > gb->rss ? -1 : 1;
+        return strcmp(ga->path, gb->path);
+}
+
+void
+cgroup_group_procs(const proc_ptr_array *procs,
+                   double uptime,
+                   proc_ptr_array *members,
+                   cgroup_group_array *out)
+{
+        members->len = 0;
+        out->len = 0;
+
+        for (size_t i = 0; i < procs->len; ++i) {
+                proc *p = procs->data[i];
+                if (p->thread || !proc_load(p, PF_CGROUP | PF_STAT)) continue;
+                dyn_array_append(*members, p);
+        }
+
+        if (members->len == 0) return;
+        qsort(members->data, members->len, sizeof(proc *), by_cgroup);
+
+        for (size_t i = 0; i < members->len; ++i) {
+                const proc *p = members->data[i];
+                if (out->len == 0 || out->data[out->len-1].path != p->cgroup) {
+                        dyn_array_append(*out, ((cgroup_group) {
+                                .path = p->cgroup,
+                                .first = i,
+                                .count = 0,
+                                .cpu = 0.0,
+                                .rss = 0,
+                        }));
+                }
+                cgroup_group *g = &out->data[out->len-1];
+                g->count++;
+                g->cpu += proc_cpu_percent(p, uptime);
+                g->rss += p->rss;
+        }
+
+        qsort(out->data, out->len, sizeof(cgroup_group), by_rss);
+}
+
+// `path` is absolute within the hierarchy, make it relative
+// to the cgroup root for openat().
+static int
+open_cgroup_file(const char *path,
+                 const char *file,
+                 int flags)
+{
+        char buf[4096];
+        while (*path == '/') ++path;
+        snprintf(buf, sizeof(buf), "%s%s%s", path, *path ? "/" : "", file);
+        return openat(cgroup_dirfd, buf, flags | O_CLOEXEC);
+}
+
+// Our own cgroup, the v2 one if there is one, like proc.c does
+// for every process. Always the real /proc, not --proc-root.
+static int
+own_cgroup(char *buf,
+           size_t cap)
+{
+        FILE *f = fopen("/proc/self/cgroup", "re");
+        if (!f) return 0;
+
+        char line[4096];
+        int found = 0;
+        while (fgets(line, sizeof(line), f)) {
+                char *colon = strchr(line, ':');
+                char *path = colon ? strchr(colon + 1, ':') : NULL;
+                if (!path || (found && strncmp(line, "0::", 3))) continue;
+                snprintf(buf, cap, "%.*s", (int)strcspn(path + 1, "\n"), path + 1);
+                found = 1;
+                if (!strncmp(line, "0::", 3)) break;
+        }
+        fclose(f);
+        return found;
+}
+
+int
+cgroup_is_protected(const char *path)
+{
+        const char *rel = path + strspn(path, "/");
+        if (!*rel) return 1;
+
+        // An ancestor of ours would take us down too
+        char own[4096];
+        if (!own_cgroup(own, sizeof(own))) return 0;
+        size_t len = strlen(path);
+        while (len > 1 && path[len - 1] == '/') --len;
+        return !strncmp(own, path, len) && (own[len] == '\0' || own[len] == '/');
+}
+
+int
+cgroup_kill(const cgroup_group *g,
+            const proc_ptr_array *members)
+{
+        if (cgroup_is_protected(g->path)) {
+                errno = EPERM;
+                return -1;
+        }
+
+        if (cgroup_dirfd == -1) {
+                cgroup_root_open("/sys/fs/cgroup");
+        }
+
+        int killed = 0;
+
+        // Only the unified hierarchy has cgroup.controllers at its
+        // root. On v1 the path we parsed belongs to some controller
+        // hierarchy and names nothing under the root, so neither
+        // cgroup.kill nor cgroup.procs can be trusted there.
+        int v2 = faccessat(cgroup_dirfd, "cgroup.controllers", F_OK, 0) == 0;
+
+        if (v2) {
+                // One write and the kernel takes down the whole tree,
+                // including anything forked while we were looking.
+                int fd = open_cgroup_file(g->path, "cgroup.kill", O_WRONLY);
+                if (fd != -1) {
+                        ssize_t n = write(fd, "1", 1);
+                        int err = errno;
+                        close(fd);
+                        if (n == 1) return 0;
+                        // Only EINVAL means the write itself is not
+                        // supported; EACCES and friends get reported.
+                        if (err != EINVAL) {
+                                errno = err;
+                                return -1;
+                        }
+                } else if (errno != ENOENT) {
+                        return -1;
+                }
+
+                // No cgroup.kill (a kernel before 5.14), so signal
+                // what the kernel says is in the group ...
+                FILE *procs = NULL;
+                fd = open_cgroup_file(g->path, "cgroup.procs", O_RDONLY);
+                if (fd != -1 && (procs = fdopen(fd, "r"))) {
+                        long pid;
+                        while (fscanf(procs, "%ld", &pid) == 1) {
+                                if (kill((pid_t)pid, SIGKILL) == 0) ++killed;
+                        }
+                        fclose(procs);
+                        if (killed) return killed;
+                } else if (fd != -1) {
+                        close(fd);
+                }
+        }
+
+        // ... or what we saw in it during the scan (always on v1).
+        int err = 0;
+        for (size_t i = g->first; i < g->first + g->count; ++i) {
+                if (kill(members->data[i]->pid, SIGKILL) == 0) ++killed;
+                else err = errno;
+        }
+
+        if (!killed && err) {
+                errno = err;
+                return -1;
+        }
+        return killed;
+}
+
+void
+cgroup_cleanup(void)
+{
+        if (cgroup_dirfd != -1) {
+                close(cgroup_dirfd);
+                cgroup_dirfd = -1;
+        }
+}
@@ -0,0 +1,149 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "collapse.h"
+
+typedef struct {
+        const char *user;
+        uid_t uid;        // tells apart users without a name
+        const char *cmd;  // NULL if the slot is empty
+        size_t group;
+} slot;
+
+// Reused between calls, this runs on every keystroke.
+static struct {
+        slot *slots;
+        size_t cap;       // power of two
+        size_t *group_of; // group of each member, in scan order
+        size_t *next;     // next free member index of each group
+        proc **sorted;
+        size_t n;         // room in group_of, next and sorted
+} map = {0};
+
+static size_t
+hash(const char *user,
+     const char *cmd)
+{
+        uint64_t k = (uint64_t)(uintptr_t)cmd * 0x9e3779b97f4a7c15ull;
+        k ^= (uint64_t)(uintptr_t)user + (k >> 29);
+        k *= 0xbf58476d1ce4e5b9ull;
+        return (size_t)(k ^ (k >> 31));
+}
+
+static int
+by_size(const void *a,
+        const void *b)
+{
+        const collapse_group *ga = a, *gb = b;
+        if (ga->count != gb->count) return ga->count > gb->count ? -1 : 1;
+        if (ga->rss != gb->rss) return ga->rss > gb->rss ? -1 : 1;
+        return strcmp(ga->cmd, gb->cmd);
+}
+
+static int
+reserve(size_t n)
+{
+        size_t cap = 256;
+        while (cap < n * 2) cap *= 2;
+        if (cap > map.cap) {
+                slot *slots = malloc(cap * sizeof(*slots));
+                if (!slots) return -1;
+                free(map.slots);
+                map.slots = slots;
+                map.cap = cap;
+        }
+        if (n > map.n) {
+                free(map.group_of);
+                free(map.next);
+                free(map.sorted);
+                map.group_of = malloc(n * sizeof(*map.group_of));
+                map.next = malloc(n * sizeof(*map.next));
+                map.sorted = malloc(n * sizeof(*map.sorted));
+                map.n = map.group_of && map.next && map.sorted ? n : 0;
+                if (!map.n) return -1;
+        }
+        memset(map.slots, 0, map.cap * sizeof(*map.slots));
+        return 0;
+}
+
+void
+collapse_procs(const proc_ptr_array *procs,
+               double uptime,
+               proc_ptr_array *members,
+               collapse_group_array *out)
+{
+        members->len = 0;
+        out->len = 0;
+        if (procs->len == 0 || reserve(procs->len) == -1) return;
+
+        // Find the group of each process, by pointer: interned
+        // commands are equal exactly when their pointers are ...
+        size_t mask = map.cap - 1;
+        for (size_t i = 0; i < procs->len; ++i) {
+                proc *p = procs->data[i];
+                if (p->thread || !proc_load(p, PF_DEFAULT | PF_STAT)) continue;
+                const char *cmd = p->cmd ? p->cmd : "";
+
+                size_t j = hash(p->user, cmd) & mask;
+                while (map.slots[j].cmd && (map.slots[j].cmd != cmd || map.slots[j].user != p->user
+                                            || (!p->user && map.slots[j].uid != p->uid))) {
+                        j = (j + 1) & mask;
+                }
+                if (!map.slots[j].cmd) {
+                        map.slots[j] = (slot) { .user = p->user, .uid = p->uid, .cmd = cmd, .group = out->len };
+                        dyn_array_append(*out, ((collapse_group) { .user = p->user, .uid = p->uid, .cmd = cmd }));
+                }
+
+                collapse_group *g = &out->data[map.slots[j].group];
+                g->count++;
+                g->cpu += proc_cpu_percent(p, uptime);
+                g->rss += p->rss;
+                map.group_of[members->len] = map.slots[j].group;
+                dyn_array_append(*members, p);
+        }
+
+        // ... then lay the members out group by group, keeping
+        // the order they came in
+        size_t first = 0;
+        for (size_t g = 0; g < out->len; ++g) {
+                out->data[g].first = map.next[g] = first;
+                first += out->data[g].count;
+        }
+        for (size_t i = 0; i < members->len; ++i) {
+                map.sorted[map.next[map.group_of[i]]++] = members->data[i];
+        }
+        memcpy(members->data, map.sorted, members->len * sizeof(proc *));
+
+        qsort(out->data, out->len, sizeof(collapse_group), by_size);
+}
+
+void
+collapse_cleanup(void)
+{
+        free(map.slots);
+        free(map.group_of);
+        free(map.next);
+        free(map.sorted);
+        memset(&map, 0, sizeof(map));
+}
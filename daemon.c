@@ -0,0 +1,360 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "daemon.h"
+#include "intern.h"
+#include "proc.h"
+#include "snapshot.h"
+
+static volatile sig_atomic_t stop = 0;
+
+// The latest table, replaced by the scanner thread and sent by
+// the accept loop. Scans take a while with many processes, and
+// clients should not wait for them.
+static struct {
+        pthread_mutex_t lock;
+        pthread_cond_t wake;  // to the scanner: quit, or a client while idle
+        pthread_cond_t fresh; // to the accept loop: idle is over
+        int current;     // memfd, -1 until the first scan
+        uint64_t generation;
+        int asked;       // a client came since the last scan
+        int idle;        // nobody came, so no scans and no table
+        int quit;
+} shared = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .wake = PTHREAD_COND_INITIALIZER,
+        .fresh = PTHREAD_COND_INITIALIZER,
+        .current = -1,
+        .asked = 1, // the first table is ready before anyone asks
+};
+
+static void
+on_signal(int sig)
+{
+        (void)sig;
+        stop = 1;
+}
+
+const char *
+daemon_default_socket(void)
+{
+        static char path[108];
+        const char *dir = getenv("XDG_RUNTIME_DIR");
+        if (dir && *dir) {
+                snprintf(path, sizeof(path), "%s/xkillr.sock", dir);
+        } else {
+                snprintf(path, sizeof(path), "/tmp/xkillr-%u.sock", (unsigned)getuid());
+        }
+        return path;
+}
+
+static int
+make_addr(const char *path,
+          struct sockaddr_un *addr)
+{
+        memset(addr, 0, sizeof(*addr));
+        addr->sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr->sun_path)) {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+        strcpy(addr->sun_path, path);
+        return 0;
+}
+
+// Scans /proc into a new sealed memfd.
+static int
+publish(uint64_t generation)
+{
+        proc_ptr_array procs = dyn_array_empty(proc_ptr_array);
+        int fd = -1;
+
+        if (proc_scan(&procs, PF_DEFAULT) == -1) {
+                goto done;
+        }
+
+        fd = memfd_create("xkillr-table", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd == -1) {
+                goto done;
+        }
+
+        if (snapshot_write(fd, &procs, generation) == -1
+            || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+                close(fd);
+                fd = -1;
+        }
+
+done:
+        for (size_t i = 0; i < procs.len; ++i) {
+                proc_free(procs.data[i]);
+        }
+        dyn_array_free(procs);
+        // The snapshot has its own copies of the strings
+        intern_trim(INTERN_TRIM);
+        return fd;
+}
+
+static void
+send_fd(int conn,
+        int fd)
+{
+        char byte = 0;
+        struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+        union {
+                struct cmsghdr hdr;
+                char buf[CMSG_SPACE(sizeof(int))];
+        } ctrl;
+        struct msghdr msg = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = ctrl.buf,
+                .msg_controllen = sizeof(ctrl.buf),
+        };
+
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(c), &fd, sizeof(int));
+
+        sendmsg(conn, &msg, MSG_NOSIGNAL);
+}
+
+// Rescans and swaps in the new table every DAEMON_INTERVAL_MS
+// until told to quit, as long as clients keep coming.
+static void *
+scanner_run(void *arg)
+{
+        (void)arg;
+        pthread_mutex_lock(&shared.lock);
+        while (!shared.quit) {
+                // Nobody took the last table, so stop scanning (and
+                // let go of it) until somebody asks again.
+                if (!shared.asked) {
+                        shared.idle = 1;
+                        if (shared.current != -1) {
+                                close(shared.current);
+                                shared.current = -1;
+                        }
+                        while (!shared.quit && !shared.asked) {
+                                pthread_cond_wait(&shared.wake, &shared.lock);
+                        }
+                        if (shared.quit) break;
+                }
+                shared.asked = 0;
+
+                uint64_t generation = shared.generation + 1;
+                pthread_mutex_unlock(&shared.lock);
+                int fd = publish(generation);
+                pthread_mutex_lock(&shared.lock);
+
+                if (fd != -1) {
+                        // Clients that already have the old one keep it
+                        if (shared.current != -1) close(shared.current);
+                        shared.current = fd;
+                        shared.generation = generation;
+                }
+                shared.idle = 0;
+                pthread_cond_broadcast(&shared.fresh);
+
+                struct timespec until;
+                clock_gettime(CLOCK_REALTIME, &until);
+                until.tv_sec += DAEMON_INTERVAL_MS / 1000;
+                until.tv_nsec += (long)(DAEMON_INTERVAL_MS % 1000) * 1000000;
+                if (until.tv_nsec >= 1000000000) {
+                        until.tv_sec++;
+                        until.tv_nsec -= 1000000000;
+                }
+                while (!shared.quit && pthread_cond_timedwait(&shared.wake, &shared.lock, &until) == 0) {}
+        }
+        pthread_mutex_unlock(&shared.lock);
+        return NULL;
+}
+
+// A root daemon sees processes that hidepid hides from other
+// users, so it only serves its own user and root.
+static int
+trusted_peer(int conn)
+{
+        struct ucred cred;
+        socklen_t len = sizeof(cred);
+        return getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0
+                && (cred.uid == 0 || cred.uid == geteuid());
+}
+
+int
+daemon_run(const char *socket_path)
+{
+        struct sockaddr_un addr;
+        if (make_addr(socket_path, &addr) == -1) {
+                return -1;
+        }
+
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock == -1) {
+                return -1;
+        }
+
+        // A socket file left behind by a daemon that died.
+        if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+                close(sock);
+                errno = EADDRINUSE;
+                return -1;
+        }
+        unlink(socket_path);
+
+        // Only the owner may connect at all
+        mode_t mask = umask(0077);
+        int bound = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+        umask(mask);
+        if (bound == -1 || listen(sock, 64) == -1) {
+                int err = errno;
+                close(sock);
+                errno = err;
+                return -1;
+        }
+
+        struct sigaction sa = {0};
+        sa.sa_handler = on_signal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        // The scanner leaves SIGINT and SIGTERM to this thread
+        sigset_t block, old;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        sigaddset(&block, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+        pthread_t scanner;
+        int err = pthread_create(&scanner, NULL, scanner_run, NULL);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (err) {
+                close(sock);
+                unlink(socket_path);
+                errno = err;
+                return -1;
+        }
+
+        // Signals interrupt poll(), so `stop` is seen right away
+        while (!stop) {
+                struct pollfd pfd = { .fd = sock, .events = POLLIN };
+                if (poll(&pfd, 1, -1) <= 0) {
+                        continue;
+                }
+
+                int conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+                if (conn == -1) {
+                        continue;
+                }
+                if (trusted_peer(conn)) {
+                        pthread_mutex_lock(&shared.lock);
+                        shared.asked = 1;
+                        // An idle daemon has no table younger than
+                        // a scan, so this client waits for one.
+                        if (shared.idle) {
+                                pthread_cond_signal(&shared.wake);
+                                while (shared.idle) {
+                                        pthread_cond_wait(&shared.fresh, &shared.lock);
+                                }
+                        }
+                        if (shared.current != -1) send_fd(conn, shared.current);
+                        pthread_mutex_unlock(&shared.lock);
+                }
+                close(conn);
+        }
+
+        pthread_mutex_lock(&shared.lock);
+        shared.quit = 1;
+        pthread_cond_signal(&shared.wake);
+        pthread_mutex_unlock(&shared.lock);
+        pthread_join(scanner, NULL);
+
+        if (shared.current != -1) close(shared.current);
+        close(sock);
+        unlink(socket_path);
+        return 0;
+}
+
+int
+daemon_attach(const char *socket_path)
+{
+        struct sockaddr_un addr;
+        if (make_addr(socket_path, &addr) == -1) {
+                return -1;
+        }
+
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock == -1) {
+                return -1;
+        }
+
+        if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+                close(sock);
+                return -1;
+        }
+
+        // Only take a table from ourselves or root.
+        struct ucred cred;
+        socklen_t len = sizeof(cred);
+        if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1
+            || (cred.uid != 0 && cred.uid != getuid())) {
+                close(sock);
+                return -1;
+        }
+
+        char byte;
+        struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+        union {
+                struct cmsghdr hdr;
+                char buf[CMSG_SPACE(sizeof(int))];
+        } ctrl;
+        struct msghdr msg = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = ctrl.buf,
+                .msg_controllen = sizeof(ctrl.buf),
+        };
+
+        int fd = -1;
+        if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) == 1) {
+                struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+                if (c && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+                        memcpy(&fd, CMSG_DATA(c), sizeof(int));
+                }
+        }
+        close(sock);
+        return fd;
+}
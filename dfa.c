@@ -0,0 +1,697 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa.h"
+#include "dyn_array.h"
+
+// The NFA is built Thompson style. Every fragment ends in an
+// N_EPS node whose `out` is filled in when the fragment is
+// joined to whatever comes next.
+typedef enum {
+        N_SET,   // consumes one byte of sets[set]
+        N_SPLIT, // out and out1
+        N_EPS,
+        N_BOL,
+        N_EOL,
+        N_MATCH,
+} node_kind;
+
+typedef struct {
+        node_kind kind;
+        int out, out1;
+        int set;
+} node;
+
+typedef struct {
+        uint8_t bits[32];
+} byteset;
+
+DYN_ARRAY_TYPE(node, node_array);
+DYN_ARRAY_TYPE(byteset, byteset_array);
+DYN_ARRAY_TYPE(int, int_array);
+
+enum {
+        DS_MATCH     = 1 << 0, // the search can stop here
+        DS_EOL       = 1 << 1, // the end of input result is known
+        DS_EOL_MATCH = 1 << 2, // and it is a match
+};
+
+// A DFA state is the set of NFA nodes it stands for: the byte
+// sets waiting for input, pending `$` and the match node. A `$`
+// reached where `^` holds too is stored as ~id, so that a `^`
+// after it still passes once the `$` does.
+typedef struct {
+        uint32_t off, len; // node ids in dfa.pool, sorted
+        uint32_t hash;
+        unsigned flags;
+} dstate;
+
+DYN_ARRAY_TYPE(dstate, dstate_array);
+
+// Past this many states the cache is thrown away and rebuilt
+// from the states the next searches reach.
+#define DFA_MAX_STATES 1024
+#define DFA_HASH_SIZE  (DFA_MAX_STATES * 2) // power of two
+
+#define MAX_DEPTH 64 // of nested groups
+
+struct dfa {
+        node_array nodes;
+        byteset_array sets;
+        int root;
+        int skip; // the `.*` in front of the pattern
+        int anchors;
+        uint8_t classes[256]; // byte -> class
+        int nclasses;
+
+        dstate_array states;
+        int_array pool;
+        int32_t *trans; // DFA_MAX_STATES * nclasses, -1 until computed
+        int32_t hash[DFA_HASH_SIZE]; // state ids, -1 if empty
+        int start; // -1 until built
+
+        // Scratch space of closure()
+        uint32_t *mark;
+        uint32_t gen;
+        int_array stack;
+        int_array scratch;
+        int_array extra;
+};
+
+typedef struct {
+        int start, end;
+} frag;
+
+typedef struct {
+        dfa *d;
+        const char *s;
+        size_t len, pos;
+        int icase;
+        int depth;
+} parser;
+
+static int
+has(const byteset *set,
+    int b)
+{
+        return set->bits[b >> 3] & (1 << (b & 7));
+}
+
+static void
+put(byteset *set,
+    int b)
+{
+        set->bits[b >> 3] |= (uint8_t)(1 << (b & 7));
+}
+
+static int
+add_node(dfa *d,
+         node_kind kind,
+         int out,
+         int out1,
+         int set)
+{
+        node n = { kind, out, out1, set };
+        dyn_array_append(d->nodes, n);
+        return (int)d->nodes.len - 1;
+}
+
+static void
+patch(dfa *d,
+      int n,
+      int out)
+{
+        d->nodes.data[n].out = out;
+}
+
+static frag
+single(dfa *d,
+       node_kind kind,
+       int set)
+{
+        int e = add_node(d, N_EPS, -1, -1, -1);
+        int s = add_node(d, kind, e, -1, set);
+        return (frag){ s, e };
+}
+
+// Case folding happens here, once: with `icase` a byte is in the
+// set if its lowercase form is the lowercase form of a member,
+// which is what REG_ICASE does to both the pattern and the input.
+static int
+add_set(dfa *d,
+        const byteset *set,
+        int negate,
+        int icase)
+{
+        byteset lower = {0}, r = {0};
+        for (int b = 0; b < 256; ++b) {
+                if (has(set, b)) put(&lower, icase ? tolower(b) : b);
+        }
+        for (int b = 0; b < 256; ++b) {
+                if (!!has(&lower, icase ? tolower(b) : b) != negate) put(&r, b);
+        }
+        dyn_array_append(d->sets, r);
+        return (int)d->sets.len - 1;
+}
+
+static int
+is_meta(unsigned char c)
+{
+        return c && strchr(".[]()*+?{}|^$\\", c);
+}
+
+// Ranges like [0-9], [a-z] or [A-F]. Anything else depends on
+// how libc collates and folds the endpoints.
+static int
+simple_range(int lo,
+             int hi)
+{
+        if (lo > hi) return 0;
+        return (isdigit(lo) && isdigit(hi))
+                || (islower(lo) && islower(hi))
+                || (isupper(lo) && isupper(hi));
+}
+
+// After the `[`. Leaves collating elements and character
+// classes ([:alpha:] etc.) to libc.
+static int
+parse_bracket(parser *ps,
+              byteset *set,
+              int *negate)
+{
+        const unsigned char *s = (const unsigned char *)ps->s;
+        int first = 1;
+
+        *negate = 0;
+        if (ps->pos < ps->len && s[ps->pos] == '^') {
+                *negate = 1;
+                ps->pos++;
+        }
+
+        while (ps->pos < ps->len) {
+                int lo = s[ps->pos];
+                if (lo == ']' && !first) {
+                        ps->pos++;
+                        return 1;
+                }
+                if (lo == '[' && ps->pos + 1 < ps->len && strchr(":=.", s[ps->pos + 1])) {
+                        return 0;
+                }
+                ps->pos++;
+
+                int hi = lo;
+                if (ps->pos + 1 < ps->len && s[ps->pos] == '-' && s[ps->pos + 1] != ']') {
+                        hi = s[ps->pos + 1];
+                        if (!simple_range(lo, hi)) return 0;
+                        ps->pos += 2;
+                        // [a-c-e] is an error.
+                        if (ps->pos + 1 < ps->len && s[ps->pos] == '-' && s[ps->pos + 1] != ']') {
+                                return 0;
+                        }
+                }
+                for (int b = lo; b <= hi; ++b) put(set, b);
+                first = 0;
+        }
+        return 0;
+}
+
+static int parse_alt(parser *ps, frag *f);
+
+static int
+parse_atom(parser *ps,
+           frag *f,
+           int *anchor)
+{
+        dfa *d = ps->d;
+        unsigned char c = (unsigned char)ps->s[ps->pos++];
+        byteset set = {0};
+        int negate = 0;
+
+        *anchor = 0;
+        switch (c) {
+        case '(':
+                if (++ps->depth > MAX_DEPTH || !parse_alt(ps, f)) return 0;
+                if (ps->pos >= ps->len || ps->s[ps->pos] != ')') return 0;
+                ps->pos++;
+                ps->depth--;
+                return 1;
+        case '^':
+                d->anchors = 1;
+                *f = single(d, N_BOL, -1);
+                *anchor = 1;
+                return 1;
+        case '$':
+                d->anchors = 1;
+                *f = single(d, N_EOL, -1);
+                *anchor = 1;
+                return 1;
+        case '.':
+                memset(&set, 0xff, sizeof(set));
+                break;
+        case '[':
+                if (!parse_bracket(ps, &set, &negate)) return 0;
+                break;
+        case '\\':
+                // Only escaped metacharacters, \w, \< and friends
+                // are GNU extensions.
+                if (ps->pos >= ps->len || !is_meta((unsigned char)ps->s[ps->pos])) return 0;
+                put(&set, (unsigned char)ps->s[ps->pos++]);
+                break;
+        default:
+                if (is_meta(c) || c == '\0') return 0;
+                put(&set, c);
+                break;
+        }
+
+        *f = single(d, N_SET, add_set(d, &set, negate, ps->icase));
+        return 1;
+}
+
+static int
+parse_repeat(parser *ps,
+             frag *f)
+{
+        dfa *d = ps->d;
+        int anchor;
+
+        if (!parse_atom(ps, f, &anchor)) return 0;
+
+        while (ps->pos < ps->len) {
+                char q = ps->s[ps->pos];
+                if (q != '*' && q != '+' && q != '?') break;
+                if (anchor) return 0;
+                ps->pos++;
+
+                int e = add_node(d, N_EPS, -1, -1, -1);
+                int s = add_node(d, N_SPLIT, f->start, e, -1);
+                switch (q) {
+                case '*':
+                        patch(d, f->end, s);
+                        *f = (frag){ s, e };
+                        break;
+                case '+':
+                        patch(d, f->end, s);
+                        *f = (frag){ f->start, e };
+                        break;
+                case '?':
+                        patch(d, f->end, e);
+                        *f = (frag){ s, e };
+                        break;
+                }
+        }
+        return 1;
+}
+
+// Empty branches and groups are valid but rare, regcomp()
+// can have them.
+static int
+parse_concat(parser *ps,
+             frag *f)
+{
+        int have = 0;
+        while (ps->pos < ps->len && ps->s[ps->pos] != '|' && ps->s[ps->pos] != ')') {
+                frag g;
+                if (!parse_repeat(ps, &g)) return 0;
+                if (have) {
+                        patch(ps->d, f->end, g.start);
+                        f->end = g.end;
+                } else {
+                        *f = g;
+                }
+                have = 1;
+        }
+        return have;
+}
+
+static int
+parse_alt(parser *ps,
+          frag *f)
+{
+        dfa *d = ps->d;
+
+        if (!parse_concat(ps, f)) return 0;
+
+        while (ps->pos < ps->len && ps->s[ps->pos] == '|') {
+                frag g;
+                ps->pos++;
+                if (!parse_concat(ps, &g)) return 0;
+                int e = add_node(d, N_EPS, -1, -1, -1);
+                int s = add_node(d, N_SPLIT, f->start, g.start, -1);
+                patch(d, f->end, e);
+                patch(d, g.end, e);
+                *f = (frag){ s, e };
+        }
+        return 1;
+}
+
+// Splits the bytes into classes that every set either fully
+// contains or does not touch, so transitions are stored per
+// class instead of per byte.
+static void
+refine(dfa *d,
+       const byteset *set)
+{
+        int remap[256][2];
+        int n = 0;
+        memset(remap, 0xff, sizeof(remap));
+        for (int b = 0; b < 256; ++b) {
+                int *r = &remap[d->classes[b]][!!has(set, b)];
+                if (*r < 0) *r = n++;
+                d->classes[b] = (uint8_t)*r;
+        }
+        d->nclasses = n;
+}
+
+static void
+build_classes(dfa *d)
+{
+        memset(d->classes, 0, sizeof(d->classes));
+        d->nclasses = 1;
+        for (size_t i = 0; i < d->sets.len; ++i) {
+                refine(d, &d->sets.data[i]);
+        }
+        // Anchors treat a newline differently from other bytes.
+        if (d->anchors) {
+                byteset nl = {0};
+                put(&nl, '\n');
+                refine(d, &nl);
+        }
+}
+
+// Adds to d->scratch the nodes of the state reached from `n`
+// without consuming input. The caller bumps d->gen once per
+// state, so nodes reached from several places count once; the
+// closures where `^` holds have to come first.
+static void
+closure(dfa *d,
+        int n,
+        int bol,
+        int eol,
+        unsigned *flags)
+{
+        dyn_array_append(d->stack, n);
+        while (d->stack.len) {
+                int i = d->stack.data[--d->stack.len];
+                if (d->mark[i] == d->gen) continue;
+                d->mark[i] = d->gen;
+
+                const node *nd = &d->nodes.data[i];
+                switch (nd->kind) {
+                case N_SET:
+                        dyn_array_append(d->scratch, i);
+                        break;
+                case N_MATCH:
+                        *flags |= DS_MATCH;
+                        dyn_array_append(d->scratch, i);
+                        break;
+                case N_EPS:
+                        dyn_array_append(d->stack, nd->out);
+                        break;
+                case N_SPLIT:
+                        dyn_array_append(d->stack, nd->out1);
+                        dyn_array_append(d->stack, nd->out);
+                        break;
+                case N_BOL:
+                        if (bol) dyn_array_append(d->stack, nd->out);
+                        break;
+                case N_EOL:
+                        if (eol) dyn_array_append(d->stack, nd->out);
+                        else dyn_array_append(d->scratch, bol ? ~i : i);
+                        break;
+                }
+        }
+}
+
+static void
+flush(dfa *d)
+{
+        d->states.len = 0;
+        d->pool.len = 0;
+        memset(d->hash, 0xff, sizeof(d->hash));
+        d->start = -1;
+}
+
+static int
+int_cmp(const void *a,
+        const void *b)
+{
+        int x = *(const int *)a, y = *(const int *)b;
+        return x < y ? -1 : x > y;
+}
+
+// Finds or adds the state made of the nodes in d->scratch.
+static int
+intern_state(dfa *d,
+             unsigned flags)
+{
+        int *nodes = d->scratch.data;
+        size_t n = d->scratch.len;
+
+        if (d->states.len >= DFA_MAX_STATES) flush(d);
+
+        qsort(nodes, n, sizeof(*nodes), int_cmp);
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; ++i) {
+                h = (h ^ (uint32_t)nodes[i]) * 16777619u;
+        }
+
+        size_t mask = DFA_HASH_SIZE - 1, slot = h & mask;
+        for (; d->hash[slot] >= 0; slot = (slot + 1) & mask) {
+                const dstate *st = &d->states.data[d->hash[slot]];
+                if (st->hash == h && st->len == n
+                    && !memcmp(d->pool.data + st->off, nodes, n * sizeof(*nodes))) {
+                        return d->hash[slot];
+                }
+        }
+
+        dstate st = { (uint32_t)d->pool.len, (uint32_t)n, h, flags };
+        for (size_t i = 0; i < n; ++i) {
+                dyn_array_append(d->pool, nodes[i]);
+        }
+        dyn_array_append(d->states, st);
+        int id = (int)d->states.len - 1;
+        d->hash[slot] = id;
+
+        memset(d->trans + (size_t)id * d->nclasses, 0xff, (size_t)d->nclasses * sizeof(*d->trans));
+        return id;
+}
+
+static int
+start_state(dfa *d)
+{
+        if (d->start < 0) {
+                unsigned flags = 0;
+                d->scratch.len = 0;
+                d->gen++;
+                closure(d, d->root, 1, 0, &flags);
+                d->start = intern_state(d, flags);
+        }
+        return d->start;
+}
+
+// Lets the pending `$` of a state through, as at the end of
+// the input or before a newline.
+static void
+pass_eol(dfa *d,
+         const dstate *st,
+         unsigned *flags)
+{
+        for (size_t i = 0; i < st->len; ++i) {
+                int id = d->pool.data[st->off + i];
+                if (id < 0) {
+                        closure(d, d->nodes.data[~id].out, 1, 1, flags);
+                } else if (d->nodes.data[id].kind == N_EOL) {
+                        closure(d, d->nodes.data[id].out, 0, 1, flags);
+                }
+        }
+}
+
+static void
+advance(dfa *d,
+        int id,
+        unsigned char byte,
+        int bol,
+        unsigned *flags)
+{
+        const node *nd = &d->nodes.data[id];
+        if (nd->kind == N_SET && has(&d->sets.data[nd->set], byte)) {
+                closure(d, nd->out, bol, 0, flags);
+        }
+}
+
+// The transition from `from` on `byte` (of class `cls`),
+// the first time it is taken.
+//
+// Like glibc without REG_NEWLINE, `^` and `$` also hold next to
+// a newline, but only one the match itself consumes: `.^` finds
+// "\nx" while `^x` does not find "\nx".
+static int
+step(dfa *d,
+     int from,
+     int cls,
+     unsigned char byte)
+{
+        const dstate *st = &d->states.data[from];
+        int nl = byte == '\n';
+        unsigned flags = 0;
+
+        d->extra.len = 0;
+        if (nl && d->anchors) {
+                d->scratch.len = 0;
+                d->gen++;
+                pass_eol(d, st, &flags);
+                for (size_t i = 0; i < d->scratch.len; ++i) {
+                        if (d->scratch.data[i] >= 0) dyn_array_append(d->extra, d->scratch.data[i]);
+                }
+                flags = 0;
+        }
+
+        d->scratch.len = 0;
+        d->gen++;
+        for (size_t i = 0; i < st->len; ++i) {
+                int id = d->pool.data[st->off + i];
+                if (id >= 0 && id != d->skip) advance(d, id, byte, nl, &flags);
+        }
+        for (size_t i = 0; i < d->extra.len; ++i) {
+                advance(d, d->extra.data[i], byte, 1, &flags);
+        }
+        advance(d, d->skip, byte, 0, &flags);
+
+        // A flush would take `from` with it.
+        int full = d->states.len >= DFA_MAX_STATES;
+        int to = intern_state(d, flags);
+        if (!full) d->trans[(size_t)from * d->nclasses + cls] = to;
+        return to;
+}
+
+static int
+eol_match(dfa *d,
+          int id)
+{
+        if (!(d->states.data[id].flags & DS_EOL)) {
+                unsigned flags = 0;
+                d->scratch.len = 0;
+                d->gen++;
+                pass_eol(d, &d->states.data[id], &flags);
+                d->states.data[id].flags |= DS_EOL | (flags & DS_MATCH ? DS_EOL_MATCH : 0);
+        }
+        return !!(d->states.data[id].flags & DS_EOL_MATCH);
+}
+
+dfa *
+dfa_compile(const char *pattern,
+            size_t len,
+            int icase)
+{
+        dfa *d = calloc(1, sizeof(*d));
+        if (!d) return NULL;
+
+        parser ps = { d, pattern, len, 0, icase, 0 };
+        frag f;
+        if (!parse_alt(&ps, &f) || ps.pos != len) {
+                dfa_free(d);
+                return NULL;
+        }
+        patch(d, f.end, add_node(d, N_MATCH, -1, -1, -1));
+
+        // Searching is matching `.*` followed by the pattern.
+        byteset any;
+        memset(&any, 0xff, sizeof(any));
+        dyn_array_append(d->sets, any);
+        int loop = add_node(d, N_SPLIT, f.start, -1, -1);
+        int skip = add_node(d, N_SET, loop, -1, (int)d->sets.len - 1);
+        d->nodes.data[loop].out1 = skip;
+        d->root = loop;
+        d->skip = skip;
+
+        build_classes(d);
+        d->mark = calloc(d->nodes.len, sizeof(*d->mark));
+        // Room for every state up front, so that matching never has
+        // to grow it and running out shows here, where regcomp()
+        // can still take over. Pages no state reaches stay untouched.
+        d->trans = malloc((size_t)DFA_MAX_STATES * d->nclasses * sizeof(*d->trans));
+        if (!d->mark || !d->trans) {
+                dfa_free(d);
+                return NULL;
+        }
+        flush(d);
+        return d;
+}
+
+int
+dfa_build_all(dfa *d)
+{
+        // Bytes of a class all lead to the same state, any one
+        // of them will do.
+        unsigned char rep[256];
+        for (int b = 255; b >= 0; --b) {
+                rep[d->classes[b]] = (unsigned char)b;
+        }
+
+        start_state(d);
+        for (size_t id = 0; id < d->states.len; ++id) {
+                for (int cls = 0; cls < d->nclasses; ++cls) {
+                        if (d->trans[id * d->nclasses + cls] >= 0) continue;
+                        // One more state would flush the others
+                        if (d->states.len >= DFA_MAX_STATES) return 0;
+                        step(d, (int)id, cls, rep[cls]);
+                }
+                eol_match(d, (int)id);
+        }
+        return 1;
+}
+
+int
+dfa_match(dfa *d,
+          const char *s)
+{
+        const unsigned char *p = (const unsigned char *)s;
+        int st = start_state(d);
+
+        for (;; ++p) {
+                if (d->states.data[st].flags & DS_MATCH) return 1;
+                if (!*p) return eol_match(d, st);
+                int cls = d->classes[*p];
+                int next = d->trans[(size_t)st * d->nclasses + cls];
+                st = next >= 0 ? next : step(d, st, cls, *p);
+        }
+}
+
+void
+dfa_free(dfa *d)
+{
+        if (!d) return;
+        dyn_array_free(d->nodes);
+        dyn_array_free(d->sets);
+        dyn_array_free(d->states);
+        dyn_array_free(d->pool);
+        dyn_array_free(d->stack);
+        dyn_array_free(d->scratch);
+        dyn_array_free(d->extra);
+        free(d->trans);
+        free(d->mark);
+        free(d);
+}
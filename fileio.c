@@ -0,0 +1,412 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "fileio.h"
+
+#define MAX_WORKERS 8
+
+// Chains in flight per io_uring_enter(). Each one has its own
+// registered file slot, and takes three SQEs.
+#define URING_DEPTH 256
+#define URING_ENTRIES 1024
+
+static size_t
+read_one(int dirfd,
+         file_read *r)
+{
+        int fd = openat(dirfd, r->path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+                r->len = -1;
+                return 1;
+        }
+
+        size_t n = 0, calls = 2; // openat, close
+        while (n < r->cap - 1) {
+                ssize_t got = read(fd, r->buf + n, r->cap - 1 - n);
+                ++calls;
+                if (got <= 0) break;
+                n += (size_t)got;
+        }
+        close(fd);
+        r->buf[n] = '\0';
+        r->len = (ssize_t)n;
+        return calls;
+}
+
+static size_t
+read_sync(int dirfd,
+          file_read *reqs,
+          size_t n)
+{
+        size_t calls = 0;
+        for (size_t i = 0; i < n; ++i) {
+                calls += read_one(dirfd, &reqs[i]);
+        }
+        return calls;
+}
+
+typedef struct {
+        int dirfd;
+        file_read *reqs;
+        size_t n;
+        atomic_size_t next;
+        atomic_size_t calls;
+} thread_job;
+
+static void *
+worker_run(void *arg)
+{
+        thread_job *job = arg;
+        size_t calls = 0;
+        for (;;) {
+                size_t i = atomic_fetch_add(&job->next, 1);
+                if (i >= job->n) break;
+                calls += read_one(job->dirfd, &job->reqs[i]);
+        }
+        atomic_fetch_add(&job->calls, calls);
+        return NULL;
+}
+
+static size_t
+read_threads(int dirfd,
+             file_read *reqs,
+             size_t n)
+{
+        thread_job job = { .dirfd = dirfd, .reqs = reqs, .n = n };
+        atomic_init(&job.next, 0);
+        atomic_init(&job.calls, 0);
+
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t nworkers = ncpu > 0 ? (size_t)ncpu : 1;
+        if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+        if (nworkers > n / 64 + 1) nworkers = n / 64 + 1;
+
+        // Worker 0 runs on this thread.
+        pthread_t threads[MAX_WORKERS];
+        size_t started = 1;
+        for (; started < nworkers; ++started) {
+                if (pthread_create(&threads[started], NULL, worker_run, &job) != 0) break;
+        }
+        worker_run(&job);
+        for (size_t i = 1; i < started; ++i) {
+                pthread_join(threads[i], NULL);
+        }
+
+        return atomic_load(&job.calls) + (started - 1) * 2; // clone, join
+}
+
+typedef struct {
+        int fd;
+        unsigned *sq_tail, *sq_mask, *sq_array;
+        unsigned *cq_head, *cq_tail, *cq_mask;
+        struct io_uring_sqe *sqes;
+        struct io_uring_cqe *cqes;
+        void *sq_ring, *cq_ring;
+        size_t sq_ring_len, cq_ring_len, sqes_len;
+} uring;
+
+// One ring per thread: the UI and the background refresher can
+// both be scanning, and a ring's queues and file slots must not
+// be shared. A thread's ring is torn down when it exits.
+static _Thread_local uring ring = { .fd = -1 };
+static _Thread_local int ring_state = 0; // 0 untried, 1 usable, -1 unavailable
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static int
+uring_setup(void)
+{
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        int fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+        if (fd == -1) {
+                return -1;
+        }
+        ring.fd = fd;
+
+        ring.sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring.cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                if (ring.cq_ring_len > ring.sq_ring_len) ring.sq_ring_len = ring.cq_ring_len;
+                ring.cq_ring_len = 0;
+        }
+
+        ring.sq_ring = mmap(NULL, ring.sq_ring_len, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (ring.sq_ring == MAP_FAILED) {
+                ring.sq_ring = NULL;
+                return -1;
+        }
+
+        if (ring.cq_ring_len) {
+                ring.cq_ring = mmap(NULL, ring.cq_ring_len, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                if (ring.cq_ring == MAP_FAILED) {
+                        ring.cq_ring = NULL;
+                        return -1;
+                }
+        }
+        char *cq = ring.cq_ring ? ring.cq_ring : ring.sq_ring;
+
+        ring.sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+        ring.sqes = mmap(NULL, ring.sqes_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (ring.sqes == MAP_FAILED) {
+                ring.sqes = NULL;
+                return -1;
+        }
+
+        char *sq = ring.sq_ring;
+        ring.sq_tail = (unsigned *)(sq + params.sq_off.tail);
+        ring.sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+        ring.sq_array = (unsigned *)(sq + params.sq_off.array);
+        ring.cq_head = (unsigned *)(cq + params.cq_off.head);
+        ring.cq_tail = (unsigned *)(cq + params.cq_off.tail);
+        ring.cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+        ring.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+        // OPENAT/CLOSE on registered files came later than the
+        // opcodes themselves; that is caught on the first batch.
+        struct io_uring_probe *probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+        if (!probe) return -1;
+        int ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0
+                && probe->last_op >= IORING_OP_CLOSE
+                && probe->last_op >= IORING_OP_READ
+                && (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED)
+                && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+                && (probe->ops[IORING_OP_CLOSE].flags & IO_URING_OP_SUPPORTED);
+        free(probe);
+        if (!ok) return -1;
+
+        // An empty slot per chain for the opened files.
+        int fds[URING_DEPTH];
+        for (size_t i = 0; i < URING_DEPTH; ++i) fds[i] = -1;
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES, fds, URING_DEPTH) != 0) {
+                return -1;
+        }
+
+        return 0;
+}
+
+static void
+uring_teardown(void)
+{
+        if (ring.sqes) munmap(ring.sqes, ring.sqes_len);
+        if (ring.cq_ring) munmap(ring.cq_ring, ring.cq_ring_len);
+        if (ring.sq_ring) munmap(ring.sq_ring, ring.sq_ring_len);
+        if (ring.fd != -1) close(ring.fd);
+        ring = (uring) { .fd = -1 };
+}
+
+static void
+ring_exit(void *arg)
+{
+        (void)arg;
+        uring_teardown();
+}
+
+static void
+make_ring_key(void)
+{
+        pthread_key_create(&ring_key, ring_exit);
+}
+
+static struct io_uring_sqe *
+next_sqe(unsigned *tail)
+{
+        unsigned i = *tail & *ring.sq_mask;
+        struct io_uring_sqe *sqe = &ring.sqes[i];
+        memset(sqe, 0, sizeof(*sqe));
+        ring.sq_array[i] = i;
+        ++*tail;
+        return sqe;
+}
+
+// Runs up to URING_DEPTH reads. Returns the number of
+// io_uring_enter() calls, or 0 if io_uring can't do it.
+static size_t
+uring_batch(int dirfd,
+            file_read *reqs,
+            size_t n)
+{
+        unsigned tail = *ring.sq_tail;
+
+        for (size_t i = 0; i < n; ++i) {
+                reqs[i].len = -1;
+
+                // Opens straight into file slot i, which the next
+                // two requests of the chain use.
+                struct io_uring_sqe *sqe = next_sqe(&tail);
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = dirfd;
+                sqe->addr = (uintptr_t)reqs[i].path;
+                sqe->open_flags = O_RDONLY;
+                sqe->file_index = (uint32_t)i + 1;
+                sqe->flags = IOSQE_IO_LINK;
+                sqe->user_data = i * 3;
+
+                sqe = next_sqe(&tail);
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = (int)i;
+                sqe->addr = (uintptr_t)reqs[i].buf;
+                sqe->len = (uint32_t)(reqs[i].cap - 1);
+                sqe->off = 0;
+                // Close even if the read fails.
+                sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+                sqe->user_data = i * 3 + 1;
+
+                sqe = next_sqe(&tail);
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->file_index = (uint32_t)i + 1;
+                sqe->user_data = i * 3 + 2;
+        }
+        __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+        size_t want = n * 3, submitted = 0, done = 0, calls = 0, einval = 0;
+        while (done < want) {
+                int r = (int)syscall(__NR_io_uring_enter, ring.fd,
+                                     (unsigned)(want - submitted),
+                                     (unsigned)(want - done),
+                                     IORING_ENTER_GETEVENTS, NULL, 0);
+                ++calls;
+                if (r < 0) {
+                        if (errno == EINTR) continue;
+                        return 0;
+                }
+                submitted += (size_t)r;
+
+                unsigned head = *ring.cq_head;
+                unsigned ctail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+                for (; head != ctail; ++head, ++done) {
+                        const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+                        size_t i = cqe->user_data / 3;
+                        switch (cqe->user_data % 3) {
+                        case 0:
+                                if (cqe->res == -EINVAL) ++einval;
+                                break;
+                        case 1:
+                                if (cqe->res >= 0) {
+                                        reqs[i].buf[cqe->res] = '\0';
+                                        reqs[i].len = cqe->res;
+                                }
+                                break;
+                        default: break;
+                        }
+                }
+                __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        // Kernels without direct descriptors reject every open.
+        if (einval == n) {
+                return 0;
+        }
+        return calls;
+}
+
+static size_t
+read_uring(int dirfd,
+           file_read *reqs,
+           size_t n)
+{
+        if (ring_state == 0) {
+                ring_state = uring_setup() == 0 ? 1 : -1;
+                if (ring_state == -1) {
+                        uring_teardown();
+                } else {
+                        // The value only has to be non-NULL for the
+                        // destructor to run
+                        pthread_once(&ring_key_once, make_ring_key);
+                        pthread_setspecific(ring_key, &ring);
+                }
+        }
+
+        size_t calls = 0;
+        for (size_t i = 0; ring_state == 1 && i < n; i += URING_DEPTH) {
+                size_t m = n - i < URING_DEPTH ? n - i : URING_DEPTH;
+                size_t c = uring_batch(dirfd, reqs + i, m);
+                if (c == 0) {
+                        ring_state = -1;
+                        uring_teardown();
+                        return calls + read_sync(dirfd, reqs + i, n - i);
+                }
+                calls += c;
+        }
+
+        if (ring_state == -1) {
+                return read_sync(dirfd, reqs, n);
+        }
+        return calls;
+}
+
+size_t
+fileio_read(fileio_backend backend,
+            int dirfd,
+            file_read *reqs,
+            size_t n)
+{
+        switch (backend) {
+        case FIO_THREADS: return read_threads(dirfd, reqs, n);
+        case FIO_URING: return read_uring(dirfd, reqs, n);
+        default: return read_sync(dirfd, reqs, n);
+        }
+}
+
+static const char *backend_names[] = {
+        [FIO_SYNC] = "sync",
+        [FIO_THREADS] = "threads",
+        [FIO_URING] = "uring",
+};
+
+int
+fileio_backend_from_name(const char *name)
+{
+        for (size_t i = 0; i < sizeof(backend_names)/sizeof(*backend_names); ++i) {
+                if (!strcmp(name, backend_names[i])) return (int)i;
+        }
+        return -1;
+}
+
+const char *
+fileio_backend_name(fileio_backend backend)
+{
+        return backend_names[backend];
+}
+
+// Only tears down the calling thread's ring.
+void
+fileio_cleanup(void)
+{
+        uring_teardown();
+        ring_state = 0;
+}
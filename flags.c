@@ -21,6 +21,7 @@
 #include <stdlib.h>
 
 #include "flags.h"
+#include "table.h"
 #include "copying.h"
 #include "config.h"
 
@@ -31,6 +32,11 @@ controls(void)
         printf("    CTRL + q -> quit\n");
         printf("    UP -> scroll up\n");
         printf("    DOWN -> scroll down\n");
+        printf("    TAB -> show/hide threads\n");
+        printf("    CTRL + g -> group by cgroup\n");
+        printf("    CTRL + f -> rank parents by spawn rate\n");
+        printf("    CTRL + d -> collapse identical commands\n");
+        printf("    CTRL + t -> show/hide the --stats status line\n");
         printf("Type other characters to filter processes.\n");
         exit(0);
 }
@@ -66,6 +72,29 @@ usage(void)
         printf("    -%c, --%s       show running procs\n", FLAG_1HY_LIST, FLAG_2HY_LIST);
         printf("    -%c, --%s   show controls\n", FLAG_1HY_CONTROLS, FLAG_2HY_CONTROLS);
         printf("        --%s    show copying information\n", FLAG_2HY_COPYING);
+        printf("        --%s      index commands for faster searching\n", FLAG_2HY_INDEX);
+        printf("        --%s N     only show procs holding local port N\n", FLAG_2HY_PORT);
+        printf("        --%s DIR    read processes from DIR (default: /proc)\n", FLAG_2HY_PROC_ROOT);
+        printf("        --%s MS       rescan in the background every MS milliseconds (default: 0, never; try 2000)\n",
+               FLAG_2HY_REFRESH);
+        printf("        --%s P%%    refresh no more often than fits in P%% of one CPU (default: %g%%, 0: no limit)\n",
+               FLAG_2HY_CPU_BUDGET, TABLE_CPU_BUDGET * 100);
+        printf("        --%s R         how to read /proc: sync, threads or uring (default: sync)\n", FLAG_2HY_READER);
+        printf("        --%s FILE   write the process table to FILE and exit (unless -l)\n", FLAG_2HY_SNAPSHOT_OUT);
+        printf("        --%s FILE    read the process table from FILE instead of /proc\n", FLAG_2HY_SNAPSHOT_IN);
+        printf("        --%s[=FILE]     time the scan, filter and render phases, print JSON on exit\n", FLAG_2HY_STATS);
+        printf("        --%s FILE      run headless, typing the keys in FILE, and report latencies\n", FLAG_2HY_REPLAY);
+        printf("        --%s DIR  cgroup hierarchy (default: /sys/fs/cgroup)\n", FLAG_2HY_CGROUP_ROOT);
+        printf("        --%s[=ROWS]    draw ROWS (default: 15) rows below the prompt instead of full screen\n", FLAG_2HY_INLINE);
+        printf("        --%s FILE       signal processes matching the rules in FILE, see watch.h\n", FLAG_2HY_WATCH);
+        printf("        --%s      with --%s or --%s, only log what would be sent\n",
+               FLAG_2HY_DRY_RUN, FLAG_2HY_WATCH, FLAG_2HY_PRESSURE_RULE);
+        printf("        --%s[=TRIGGER]  on memory pressure, list the largest processes, see pressure.h\n", FLAG_2HY_ON_PRESSURE);
+        printf("        --%s R  with --%s, signal the largest process matching \"TERMS -> SIGNAL\"\n",
+               FLAG_2HY_PRESSURE_RULE, FLAG_2HY_ON_PRESSURE);
+        printf("        --%s       keep the process table in memory for other xkillr's\n", FLAG_2HY_DAEMON);
+        printf("        --%s    always scan, even if a daemon is running\n", FLAG_2HY_NO_DAEMON);
+        printf("        --%s PATH   daemon socket (default: $XDG_RUNTIME_DIR/xkillr.sock)\n", FLAG_2HY_SOCKET);
         exit(0);
 }
 
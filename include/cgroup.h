@@ -0,0 +1,64 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CGROUP_H_INCLUDED
+#define CGROUP_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "proc.h"
+
+typedef struct {
+        const char *path; // interned
+        size_t first;     // index of the first member in the member array
+        size_t count;
+        double cpu;       // sum of proc_cpu_percent()
+        uint64_t rss;     // bytes
+} cgroup_group;
+
+DYN_ARRAY_TYPE(cgroup_group, cgroup_group_array);
+
+int cgroup_root_open(const char *path);
+
+// Groups `procs` by cgroup. `members` receives the procs sorted
+// by cgroup, and each group refers to a range of it. Groups are
+// ordered by RSS, largest first. `uptime` is for their CPU usage.
+void cgroup_group_procs(const proc_ptr_array *procs,
+                        double uptime,
+                        proc_ptr_array *members,
+                        cgroup_group_array *out);
+
+// Whether killing the cgroup at `path` would take down the
+// whole system (the root cgroup) or xkillr itself (its own
+// cgroup or one above it).
+int cgroup_is_protected(const char *path);
+
+// Kills every process in the cgroup of `g` with cgroup.kill, or
+// falls back to sending SIGKILL to each member when there is no
+// cgroup.kill (cgroup v1, or ENOENT/EINVAL on v2). Returns the
+// number of processes signaled by the fallback (0 if
+// cgroup.kill was used), or -1 on error with errno set (EPERM
+// for a protected cgroup, or why cgroup.kill failed).
+int cgroup_kill(const cgroup_group *g,
+                const proc_ptr_array *members);
+
+void cgroup_cleanup(void);
+
+#endif // CGROUP_H_INCLUDED
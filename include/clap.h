@@ -87,6 +87,13 @@ static int clap_next(Clap_Arg *clap_arg) {
         return 1;
 }
 
+// Returns the value of an option, either the part after
+// `=` (--opt=value) or the next argument (--opt value).
+static char *clap_value(Clap_Arg *clap_arg) {
+        if (clap_arg->eq) return clap_arg->eq;
+        return __clap_eat();
+}
+
 #endif // CLAP_IMPL
 
 #endif // CLAP_H
@@ -0,0 +1,60 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef COLLAPSE_H_INCLUDED
+#define COLLAPSE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "proc.h"
+
+/*
+ * Collapses processes that run the same command as the same
+ * user (hundreds of php-fpm or postgres workers) into one row.
+ * Commands are interned by the scanner and users come from the
+ * uid cache, so a group is keyed by two pointers and found with
+ * one probe of a hash map. Snapshots keep those strings shared,
+ * so the same goes for their procs.
+ */
+
+typedef struct {
+        const char *user; // NULL if the uid lookup failed
+        uid_t uid;        // of every member
+        const char *cmd;
+        size_t first;     // index of the first member in the member array
+        size_t count;
+        double cpu;       // sum of proc_cpu_percent()
+        uint64_t rss;     // bytes
+} collapse_group;
+
+DYN_ARRAY_TYPE(collapse_group, collapse_group_array);
+
+// Groups `procs` (threads are skipped) by user and command.
+// `members` receives the procs ordered by group, and each group
+// refers to a range of it. Groups are ordered by size, largest
+// first, then by RSS. `uptime` is for their CPU usage.
+void collapse_procs(const proc_ptr_array *procs,
+                    double uptime,
+                    proc_ptr_array *members,
+                    collapse_group_array *out);
+
+void collapse_cleanup(void);
+
+#endif // COLLAPSE_H_INCLUDED
@@ -0,0 +1,50 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef DAEMON_H_INCLUDED
+#define DAEMON_H_INCLUDED
+
+/*
+ * `xkillr --daemon` rescans /proc every DAEMON_INTERVAL_MS and
+ * publishes each generation of the table as a sealed memfd in the
+ * snapshot format. Clients connect to a Unix socket and receive
+ * the current memfd over SCM_RIGHTS, then map it with
+ * snapshot_open_fd(), so starting the TUI needs no scan.
+ *
+ * A published generation is never written again, so readers
+ * cannot see a half updated table. The header's `generation`
+ * tells them how fresh it is.
+ *
+ * Scans run on their own thread, so a client is answered with
+ * the latest table right away. After an interval without clients
+ * the daemon drops its table and stops scanning; the next client
+ * wakes it and waits for one scan. The socket is mode 0600, and
+ * only peers with the daemon's uid or root are served.
+ */
+
+#define DAEMON_INTERVAL_MS 1000
+
+const char *daemon_default_socket(void);
+int daemon_run(const char *socket_path);
+
+// Returns the memfd of the daemon's current table, or -1 if
+// there is no daemon (or it is not one we trust).
+int daemon_attach(const char *socket_path);
+
+#endif // DAEMON_H_INCLUDED
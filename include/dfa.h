@@ -0,0 +1,57 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef DFA_H_INCLUDED
+#define DFA_H_INCLUDED
+
+#include <stddef.h>
+
+/*
+ * A lazily built DFA for the part of POSIX extended regex that
+ * searches actually use: literals, `.`, bracket expressions with
+ * ranges and `^`, groups, `|`, `*`, `+`, `?` and the `^`/`$`
+ * anchors. Bytes that no part of the pattern can tell apart share
+ * a class, and with `icase` both cases of a letter always share
+ * one, so folding costs nothing per byte.
+ *
+ * States are built the first time a search reaches them and the
+ * transitions between them are cached, so one dfa should be kept
+ * for every string it is run on. It is not thread safe.
+ *
+ * Matches like regexec() with REG_EXTENDED | REG_NOSUB in the C
+ * locale, i.e. byte by byte.
+ */
+typedef struct dfa dfa;
+
+// NULL if the pattern uses anything outside the subset above
+// (or is not valid, or memory ran out), use regcomp() for it
+// instead.
+dfa *dfa_compile(const char *pattern, size_t len, int icase);
+
+// Builds every state and transition now, so that dfa_match()
+// no longer allocates. Returns 0 if there are too many states to
+// keep them all, the dfa then stays lazy.
+int dfa_build_all(dfa *d);
+
+// Whether `s` contains a match.
+int dfa_match(dfa *d, const char *s);
+
+void dfa_free(dfa *d);
+
+#endif // DFA_H_INCLUDED
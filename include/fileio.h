@@ -0,0 +1,63 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILEIO_H_INCLUDED
+#define FILEIO_H_INCLUDED
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Reads many small files (relative to one directory) at once.
+ * The scanner hands it a batch of /proc/<pid>/<file> reads and
+ * parses the results afterwards.
+ *
+ *   FIO_SYNC     openat/read/close, one file after the other
+ *   FIO_THREADS  the same, spread over up to 8 threads
+ *   FIO_URING    linked OPENAT -> READ -> CLOSE chains through
+ *                io_uring, a whole batch per io_uring_enter(),
+ *                on a ring of the calling thread's own
+ *
+ * FIO_URING falls back to FIO_SYNC when the kernel does not
+ * support it (or it is disabled).
+ */
+
+typedef enum {
+        FIO_SYNC = 0,
+        FIO_THREADS,
+        FIO_URING,
+} fileio_backend;
+
+typedef struct {
+        const char *path; // relative to the directory
+        char *buf;
+        size_t cap;
+        ssize_t len;      // bytes read (NUL terminated), or -1
+} file_read;
+
+// Returns the number of syscalls made.
+size_t fileio_read(fileio_backend backend, int dirfd, file_read *reqs, size_t n);
+
+// Parses "sync", "threads" or "uring". Returns -1 otherwise.
+int fileio_backend_from_name(const char *name);
+const char *fileio_backend_name(fileio_backend backend);
+
+void fileio_cleanup(void);
+
+#endif // FILEIO_H_INCLUDED
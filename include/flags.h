@@ -30,9 +30,31 @@
 #define FLAG_2HY_COPYING "copying"
 #define FLAG_2HY_VERSION "version"
 #define FLAG_2HY_CONTROLS "controls"
+#define FLAG_2HY_INDEX "index"
+#define FLAG_2HY_CGROUP_ROOT "cgroup-root"
+#define FLAG_2HY_PROC_ROOT "proc-root"
+#define FLAG_2HY_REPLAY "replay"
+#define FLAG_2HY_STATS "stats"
+#define FLAG_2HY_SNAPSHOT_OUT "snapshot-out"
+#define FLAG_2HY_SNAPSHOT_IN "snapshot-in"
+#define FLAG_2HY_PORT "port"
+#define FLAG_2HY_DAEMON "daemon"
+#define FLAG_2HY_NO_DAEMON "no-daemon"
+#define FLAG_2HY_SOCKET "socket"
+#define FLAG_2HY_READER "reader"
+#define FLAG_2HY_REFRESH "refresh"
+#define FLAG_2HY_CPU_BUDGET "cpu-budget"
+#define FLAG_2HY_WATCH "watch"
+#define FLAG_2HY_INLINE "inline"
+#define FLAG_2HY_DRY_RUN "dry-run"
+#define FLAG_2HY_ON_PRESSURE "on-pressure"
+#define FLAG_2HY_PRESSURE_RULE "pressure-rule"
 
 typedef enum {
         FT_LIST = 1 << 0,
+        FT_INDEX = 1 << 1,
+        FT_QUIT = 1 << 2,
+        FT_NO_DAEMON = 1 << 3,
 } flag_type;
 
 void usage(void);
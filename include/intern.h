@@ -0,0 +1,40 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef INTERN_H_INCLUDED
+#define INTERN_H_INCLUDED
+
+#include <stddef.h>
+
+// Returns a canonical copy of `s[0..len)`, or NULL if out of
+// memory. Equal strings give the same pointer, so interned
+// strings can be compared with `==`. The copies live until
+// intern_trim() or intern_cleanup().
+const char *intern(const char *s, size_t len);
+
+// Strings are never freed one by one, and cgroups of transient
+// units keep adding new ones. Long running modes call this
+// between scans, when no interned string is in use, to start
+// over once there are more than `max`.
+#define INTERN_TRIM 4096
+void intern_trim(size_t max);
+
+void intern_cleanup(void);
+
+#endif // INTERN_H_INCLUDED
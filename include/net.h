@@ -0,0 +1,34 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NET_H_INCLUDED
+#define NET_H_INCLUDED
+
+#include "proc.h"
+
+// Fills `out` with the sorted, unique pids that hold a TCP or UDP
+// socket (v4 or v6) whose local port is in [lo, hi]. Returns -1
+// if none of /proc/net/{tcp,tcp6,udp,udp6} could be read. The fd
+// scan stops once every socket has an owner, then follows the
+// parents and children of the owners for sockets shared by fork().
+int net_port_owners(unsigned lo,
+                    unsigned hi,
+                    pid_array *out);
+
+#endif // NET_H_INCLUDED
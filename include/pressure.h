@@ -0,0 +1,46 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PRESSURE_H_INCLUDED
+#define PRESSURE_H_INCLUDED
+
+/*
+ * `xkillr --on-pressure[=TRIGGER]` waits for memory pressure
+ * without doing anything else: it registers a PSI trigger on
+ * /proc/pressure/memory and sleeps in poll() until it fires.
+ * TRIGGER is what the kernel takes, "some|full STALL WINDOW" in
+ * microseconds, by default
+ *
+ *   some 150000 1000000    tasks stalled on memory for 150ms in a 1s window
+ *
+ * Each time it fires (or on SIGUSR1) it scans once and prints the
+ * processes using the most memory. With a rule, "TERMS -> SIGNAL"
+ * as in watch.h, it also signals the largest process matching
+ * TERMS. Rules can only use pid, ppid, uid, rss and cmd, and only
+ * regexes whose DFA can be built in full before waiting.
+ *
+ * Everything a scan needs is allocated before waiting, and locked
+ * in memory if allowed, so handling an event never calls into
+ * the allocator or waits for its own pages to come back.
+ */
+
+// With `dry_run`, only prints what it would have sent.
+int pressure_run(const char *trigger, const char *rule, int dry_run);
+
+#endif // PRESSURE_H_INCLUDED
@@ -0,0 +1,87 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROC_H_INCLUDED
+#define PROC_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "dyn_array.h"
+#include "fileio.h"
+
+// Groups of fields that are loaded together. Everything
+// in one group comes from the same file, so asking for one
+// field of a group loads all of them.
+typedef enum {
+        PF_STATUS  = 1 << 0, // cmd, uid, ppid, rss  (/proc/<pid>/status)
+        PF_USER    = 1 << 1, // user                 (getpwuid(uid))
+        PF_STAT    = 1 << 2, // utime, stime, start  (/proc/<pid>/stat)
+        PF_CMDLINE = 1 << 3, // args                 (/proc/<pid>/cmdline)
+        PF_THREADS = 1 << 4, // threads              (/proc/<pid>/task)
+        PF_CGROUP  = 1 << 5, // cgroup               (/proc/<pid>/cgroup)
+} proc_field;
+
+#define PF_DEFAULT (PF_STATUS | PF_USER)
+
+typedef struct proc proc;
+
+DYN_ARRAY_TYPE(proc *, proc_ptr_array);
+DYN_ARRAY_TYPE(pid_t, pid_array);
+
+struct proc {
+        uint32_t loaded; // proc_field mask
+        pid_t pid;       // tid for threads
+        pid_t tgid;      // == pid for processes
+        int thread;      // an entry of /proc/<tgid>/task
+        char pidstr[12];
+        char dir[32];    // relative to the proc root, "<pid>" or "<pid>/task/<tid>"
+        pid_t ppid;
+        uid_t uid;
+        uint64_t rss;    // bytes
+        uint64_t utime;  // clock ticks
+        uint64_t stime;  // clock ticks
+        uint64_t start;  // clock ticks since boot
+        const char *user; // owned by the uid cache, do not free
+        const char *cmd;  // interned, do not free
+        char *args;
+        const char *cgroup; // interned, do not free
+        int expanded;    // show threads in the TUI
+        double recent_cpu; // %, set by the TUI for threads, < 0 if unknown
+        proc_ptr_array threads;
+};
+
+int proc_root_open(const char *path);
+int proc_root_fd(void);
+int proc_pids(pid_array *out);
+int proc_scan(proc_ptr_array *out, uint32_t fields);
+void proc_set_reader(fileio_backend backend);
+int proc_load(proc *p, uint32_t fields);
+// Loads one process, or NULL if it is gone.
+proc *proc_get(pid_t pid, uint32_t fields);
+double proc_hz(void);            // clock ticks per second
+double proc_uptime(void);        // seconds, from <proc root>/uptime
+// Average over the lifetime of `p`, `uptime` from proc_uptime()
+double proc_cpu_percent(const proc *p, double uptime);
+void proc_free(proc *p);
+void proc_cleanup(void);
+
+#endif // PROC_H_INCLUDED
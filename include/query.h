@@ -0,0 +1,97 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef QUERY_H_INCLUDED
+#define QUERY_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "proc.h"
+
+/*
+ * A query is a whitespace separated list of terms that must
+ * all match (AND). Each term is either
+ *
+ *   word            case insensitive basic regex over cmd, user and
+ *                   pid (a substring unless it has . [ * ^ $ or \)
+ *   ~regex          extended regex over cmd, user and pid
+ *   field:value     a predicate on a single field
+ *
+ * optionally prefixed with `!` to negate it.
+ *
+ * String fields (user, cmd, args, cgroup, thread) take
+ *   value           case insensitive substring
+ *   =value          case insensitive equality
+ *   ~regex          case insensitive POSIX extended regex
+ *
+ * Numeric fields (pid, ppid, uid, rss, port) take
+ *   N, =N, >N, >=N, <N, <=N
+ * where N may end in K, M or G (powers of 1024).
+ *
+ * Example: user:postgres cmd:~^pg_ pid:>1000 rss:>1G !cmd:bash
+ *
+ * `port` matches the processes holding a TCP or UDP socket bound
+ * to a matching local port. Ports above 65535 are an error.
+ *
+ * `thread` matches if any thread of the process has a matching
+ * name, and is the only field that lists /proc/<pid>/task.
+ */
+
+typedef struct query query;
+
+query *query_compile(const char *src, size_t len);
+// Fails on incomplete terms instead of skipping them.
+query *query_compile_strict(const char *src, size_t len);
+int query_match(const query *q, proc *p);
+
+// `port` terms find their owners when compiled, reusing what a
+// compile of the same port range found up to a second ago. A
+// query that outlives one table (a --watch rule) must look again
+// before each use, or it would match whatever reuses those pids.
+int query_uses_port(const query *q);
+void query_resolve_ports(query *q);
+
+// Remembers string matches by pointer, so a cmd shared by a
+// hundred workers is matched once. Only for one pass over one
+// table: its strings must neither change nor be freed (and
+// another string allocated at the same address) while the
+// query is in use.
+void query_memoize(query *q);
+uint32_t query_fields(const query *q);
+
+// Builds every regex of the query up front, so that matching
+// never allocates. Fails if a term needs libc's regexec() or
+// a DFA too large to build whole.
+int query_prebuild(query *q);
+
+// Whether the query only looks at fields that stay the same
+// for the life of a process image (pid, uid, user, cmd, args),
+// so its result can be cached until the process execs.
+int query_is_static(const query *q);
+
+// A lowercased substring that every match contains in its
+// cmd, user or pid, or NULL if the query has none.
+const char *query_literal(const query *q);
+
+void query_free(query *q);
+// Frees the port owners kept between compiles.
+void query_cleanup(void);
+
+#endif // QUERY_H_INCLUDED
@@ -0,0 +1,43 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef REPLAY_H_INCLUDED
+#define REPLAY_H_INCLUDED
+
+#include <stdio.h>
+
+/*
+ * Feeds a scripted key sequence to the TUI and records how long
+ * each key takes from arrival to the end of the repaint.
+ *
+ * A script is a file of keys. Printable characters are typed as
+ * is (newlines are ignored so scripts can be wrapped), and named
+ * keys are written as <up>, <down>, <bs>, <tab>, <enter> and
+ * <c-x> for CTRL + x. The TUI quits after the last key.
+ */
+
+typedef struct replay replay;
+
+replay *replay_load(const char *path);
+int replay_next_key(replay *r);
+void replay_key_done(replay *r);
+void replay_report(const replay *r, FILE *out);
+void replay_free(replay *r);
+
+#endif // REPLAY_H_INCLUDED
@@ -0,0 +1,62 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SMAPS_H_INCLUDED
+#define SMAPS_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * PSS, USS and swap from <proc root>/<pid>/smaps_rollup. The
+ * kernel walks every mapping of the process to produce it, so
+ * it is only read for the rows on screen.
+ *
+ * Every frame the UI hands the pids it shows (plus a margin)
+ * to smaps_want(), most important first. A worker thread reads
+ * the ones that are missing or older than SMAPS_TTL_MS in that
+ * order, for at most SMAPS_FRAME_BUDGET_MS per frame, caches
+ * them, and hands the UI a copy of the cache. smaps_get() only
+ * looks at the latest copy, so drawing a row takes no lock.
+ * smaps_want() and smaps_get() are for the UI thread only.
+ */
+
+#define SMAPS_TTL_MS 3000
+#define SMAPS_FRAME_BUDGET_MS 10
+
+typedef struct {
+        uint64_t pss;  // bytes, shared pages divided among their users
+        uint64_t uss;  // bytes, private pages only
+        uint64_t swap; // bytes
+} smaps_info;
+
+int smaps_start(void);
+void smaps_want(const pid_t *pids, size_t n);
+
+// Returns 1 and fills `out` if `pid` has been read, even if
+// the result is past its TTL.
+int smaps_get(pid_t pid, smaps_info *out);
+
+// Changes whenever the worker caches a new result.
+uint64_t smaps_generation(void);
+
+void smaps_stop(void);
+
+#endif // SMAPS_H_INCLUDED
@@ -0,0 +1,91 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SNAPSHOT_H_INCLUDED
+#define SNAPSHOT_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "proc.h"
+
+/*
+ * Binary snapshot of a proc table:
+ *
+ *   snapshot_header
+ *   snapshot_record[count]
+ *   string pool (NUL terminated strings)
+ *
+ * Strings are referred to by their offset in the pool. Integers
+ * are in host byte order, a snapshot is meant to be read on the
+ * same kind of machine that wrote it.
+ */
+
+#define SNAPSHOT_MAGIC "XKILLSNP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_NO_STRING UINT32_MAX
+
+typedef struct {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t count;
+        uint64_t records_off;
+        uint64_t strings_off;
+        uint64_t strings_len;
+        uint64_t generation; // which refresh of the daemon wrote it
+        uint64_t reserved[3];
+} snapshot_header;
+
+typedef struct {
+        int32_t pid;
+        int32_t tgid;
+        int32_t ppid;
+        uint32_t uid;
+        uint64_t rss;
+        uint64_t utime;
+        uint64_t stime;
+        uint64_t start;
+        uint32_t user;   // string offsets
+        uint32_t cmd;
+        uint32_t args;
+        uint32_t cgroup;
+        char pidstr[12];
+        uint32_t thread;
+} snapshot_record;
+
+typedef struct snapshot snapshot;
+
+// Loads the missing fields of every proc and writes them to `fd`.
+int snapshot_write(int fd, const proc_ptr_array *procs, uint64_t generation);
+
+// Maps a snapshot read only. The procs are built from the records
+// when it is opened, but their strings point straight into the
+// mapping, so they are only valid until snapshot_close().
+//
+// A `live` snapshot describes processes that are still running
+// (it came from the daemon), so its threads may be loaded from
+// /proc on demand.
+snapshot *snapshot_open(const char *path);
+snapshot *snapshot_open_fd(int fd, int live);
+uint64_t snapshot_generation(const snapshot *s);
+const proc_ptr_array *snapshot_procs(const snapshot *s);
+void snapshot_close(snapshot *s);
+
+#endif // SNAPSHOT_H_INCLUDED
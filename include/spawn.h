@@ -0,0 +1,76 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPAWN_H_INCLUDED
+#define SPAWN_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "dyn_array.h"
+#include "proc.h"
+
+/*
+ * Counts the processes each parent spawns, to find fork bombs
+ * and crash looping supervisors.
+ *
+ * With CAP_NET_ADMIN, a thread listens to fork events from the
+ * kernel's proc connector, so even children that live for a
+ * millisecond are counted. Without it, spawn_observe() counts
+ * the processes that appeared since the previous table, by pid
+ * and start time, which misses the ones that came and went in
+ * between.
+ *
+ * Counters live in a small open addressing map keyed by parent
+ * pid. Each holds a total and a rate in spawns per second that
+ * decays over SPAWN_TAU_MS, so recording a spawn is a lock, a
+ * probe and an exp().
+ */
+
+#define SPAWN_TAU_MS 5000
+
+typedef struct {
+        pid_t pid;
+        uint32_t total; // since tracking started
+        double rate;    // spawns per second, recently
+} spawn_parent;
+
+DYN_ARRAY_TYPE(spawn_parent, spawn_parent_array);
+
+// Starts tracking. Returns 1 if fork events come from the
+// kernel, 0 if only spawn_observe() counts.
+int spawn_start(void);
+
+// Counts the new processes in `procs` since the last call.
+// Does nothing once fork events come from the kernel.
+void spawn_observe(const proc_ptr_array *procs);
+
+// Parents that spawned anything lately, highest rate first.
+void spawn_top(spawn_parent_array *out);
+
+// Stops `root` and every descendant with SIGSTOP, rescanning
+// until no new ones show up, then sends all of them SIGKILL.
+// Returns how many were killed, or -1 if `root` could not be
+// stopped.
+int spawn_kill_tree(pid_t root);
+
+void spawn_stop(void);
+
+#endif // SPAWN_H_INCLUDED
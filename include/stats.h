@@ -0,0 +1,74 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Instrumentation for --stats. Timings go into log2 histograms
+ * (in nanoseconds); allocations and syscalls are counted per
+ * frame, i.e. between two repaints.
+ *
+ * Everything is behind `stats_enabled`, so when it is off the
+ * cost is a load and a branch.
+ *
+ * Allocations are only counted when built with
+ * --enable-alloc-stats, which wraps malloc() and friends around
+ * glibc's __libc_malloc(), see configure.ac. Otherwise they
+ * stay at zero.
+ */
+
+typedef enum {
+        ST_SCAN = 0,            // whole /proc scan
+        ST_SCAN_PROC,           // loading one process
+        ST_GETPWUID,            // one getpwuid() call
+        ST_FILTER,              // update_filtered_procs()
+        ST_RENDER,              // dump_procs()
+        ST_FRAME_ALLOCS,        // heap allocations per frame
+        ST_FRAME_BYTES,         // bytes allocated per frame
+        ST_FRAME_FREES,         // heap frees per frame
+        ST_FRAME_SCAN_SYSCALLS, // syscalls per frame reading /proc in proc.c, no others
+        ST__COUNT,
+} stats_metric;
+
+extern int stats_enabled;
+
+uint64_t stats_now(void);
+void stats_record(stats_metric m, uint64_t value);
+void stats_count_syscalls(uint64_t n);
+void stats_frame_end(void);
+void stats_status_line(char *buf, size_t n);
+void stats_dump(FILE *out);
+
+#define STATS_BEGIN() (stats_enabled ? stats_now() : 0)
+
+#define STATS_END(m, t0)                                                \
+        do {                                                            \
+                if (stats_enabled) stats_record((m), stats_now() - (t0)); \
+        } while (0)
+
+#define STATS_SYSCALLS(n)                                       \
+        do {                                                    \
+                if (stats_enabled) stats_count_syscalls(n);     \
+        } while (0)
+
+#endif // STATS_H_INCLUDED
@@ -0,0 +1,127 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TABLE_H_INCLUDED
+#define TABLE_H_INCLUDED
+
+#include <stdint.h>
+
+#include "proc.h"
+#include "snapshot.h"
+#include "trigram.h"
+
+/*
+ * Generations of the proc table, shared between the UI thread
+ * (the only reader) and the background refresher (the only
+ * writer after startup).
+ *
+ * The writer builds a whole new table off to the side and
+ * publishes it with one atomic pointer swap. The reader pins
+ * the newest table with table_acquire() by storing it in a
+ * hazard pointer, and keeps using it until its next acquire.
+ * Replaced tables are freed by the writer once the hazard
+ * pointer no longer names them. Neither side takes a lock.
+ *
+ * A published table is never changed by the writer, and while
+ * the refresher runs the reader does not load anything either:
+ * the fields its query and view need (table_want_fields()) and
+ * the threads of the processes it shows expanded
+ * (table_want_threads()) are loaded before the table is
+ * published. Until a table has them, table_ready() says so and
+ * the UI shows nothing for them. The only exception is the
+ * process the user just expanded, whose threads are loaded
+ * right away.
+ */
+
+#define TABLE_CPU_BUDGET 0.02 // of one CPU
+
+typedef struct proc_table proc_table;
+
+struct proc_table {
+        uint64_t generation;
+        proc_ptr_array procs;
+        uint32_t fields;      // proc_field mask every proc has loaded
+        double uptime;        // proc_uptime() as of the scan
+        trigram_index *index; // NULL unless asked for
+        snapshot *snapshot;   // the procs live in it, if set
+        proc_table *retired;  // writer only
+};
+
+// Writer only, like table_publish(): they may rebuild the index
+// of a table that was freed.
+proc_table *table_scan(uint32_t fields, int index);
+// Takes ownership of `s`. Loads `fields` that it lacks, leaving
+// out the procs that are gone.
+proc_table *table_from_snapshot(snapshot *s, uint32_t fields, int index);
+void table_free(proc_table *t);
+
+void table_publish(proc_table *t);
+
+// Is there a newer table than `t`?
+int table_newer(const proc_table *t);
+
+// Pins the newest table. The previously acquired one may be
+// freed from now on.
+proc_table *table_acquire(void);
+
+// Fields the UI's query needs, so the refresher loads them up
+// front instead of the UI doing it while filtering. Asking for
+// new ones that the current table lacks rescans right away.
+void table_want_fields(uint32_t fields);
+
+// Processes whose threads the UI shows.
+void table_want_threads(const pid_t *pids, size_t n);
+
+// Can the UI use `fields` of the procs of `t`? Without a
+// refresher it loads what is missing itself.
+int table_ready(const proc_table *t, uint32_t fields);
+
+// Rescans every `interval_ms` in a background thread, or takes
+// the latest table from the daemon at `daemon_socket` if set.
+int table_refresher_start(unsigned interval_ms, int index, const char *daemon_socket);
+void table_refresher_stop(void);
+
+/*
+ * The refresher adapts `interval_ms` to what is going on:
+ *
+ *   - a quarter of it while the user is typing,
+ *   - up to 4 times it while rescans find no new or gone pids,
+ *   - 8 times it after a minute without a key, or while the
+ *     terminal does not have focus.
+ *
+ * On top of that, it never refreshes more often than the CPU
+ * budget allows, going by the average CPU time of a refresh:
+ * the rescan itself plus what the UI charges for taking the
+ * new table in.
+ */
+
+// A fraction of one CPU, 0 for no limit.
+void table_set_cpu_budget(double fraction);
+
+// The interval the refresher is waiting for right now.
+unsigned table_refresh_interval(void);
+
+void table_note_input(void);
+void table_note_focus(int focused);
+void table_charge(uint64_t ns);
+
+// Stops the refresher and frees every table.
+void table_cleanup(void);
+
+#endif // TABLE_H_INCLUDED
@@ -0,0 +1,58 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TERM_H_INCLUDED
+#define TERM_H_INCLUDED
+
+/*
+ * A small ANSI terminal writer for --inline. It reserves `rows`
+ * lines below the cursor instead of taking over the screen, puts
+ * the terminal in raw mode with termios, and needs no terminfo.
+ *
+ * Lines are drawn into one buffer and written with a single
+ * write() per frame; lines that did not change since the last
+ * frame are skipped. Cursor movement is relative, so it works
+ * wherever the prompt was.
+ */
+
+// Returns -1 if there is no terminal. `headless` draws into
+// /dev/null, for --replay. `w` and `h` get the size of the area,
+// which is smaller than `rows` on a short terminal.
+int term_open(int rows, int headless, int *w, int *h);
+
+// Clears the area and restores the terminal. Safe to call twice.
+void term_close(void);
+
+void term_line(int row, int highlight, const char *s);
+void term_invalidate(void); // redraw every line next frame
+void term_flush(void);
+
+// ncurses key codes (KEY_UP, KEY_DOWN, KEY_BACKSPACE), so the
+// input loop handles both renderers the same. ERR on timeout.
+int term_getkey(int timeout_ms);
+
+// Focus reports (ESC [ I and ESC [ O once TERM_FOCUS_ON is
+// written), as keys past the ones ncurses uses. Both renderers
+// ask the terminal for them.
+#define TERM_FOCUS_ON "\x1b[?1004h"
+#define TERM_FOCUS_OFF "\x1b[?1004l"
+#define KEY_FOCUS_IN 01001
+#define KEY_FOCUS_OUT 01002
+
+#endif // TERM_H_INCLUDED
@@ -0,0 +1,53 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRIGRAM_H_INCLUDED
+#define TRIGRAM_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "proc.h"
+
+DYN_ARRAY_TYPE(uint32_t, u32_array);
+
+/*
+ * Case insensitive trigram index over the searchable strings
+ * of a proc table (cmd, user, pid and args if loaded). Each
+ * proc is identified by its index in the table, and each
+ * trigram maps to a sorted list of those indices.
+ *
+ * The index only narrows a search down to candidates; every
+ * candidate still has to be checked with query_match().
+ */
+typedef struct trigram_index trigram_index;
+
+trigram_index *trigram_build(const proc_ptr_array *procs);
+void trigram_rebuild(trigram_index *idx, const proc_ptr_array *procs);
+
+// Fills `out` with the ids of the procs that contain every
+// trigram of `lit`. Returns 0 if `lit` is too short to use
+// the index, in which case `out` is untouched.
+int trigram_candidates(const trigram_index *idx,
+                       const char *lit,
+                       u32_array *out);
+
+void trigram_free(trigram_index *idx);
+
+#endif // TRIGRAM_H_INCLUDED
@@ -0,0 +1,56 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef WATCH_H_INCLUDED
+#define WATCH_H_INCLUDED
+
+#include <stddef.h>
+
+/*
+ * `xkillr --watch RULES` signals processes that match a rule
+ * for as long as the rule asks. One rule per line:
+ *
+ *   [NAME:] TERMS... [age>DURATION] [cpu>PERCENT] [for DURATION] -> SIGNAL
+ *
+ * TERMS are a search query (see query.h). `age` is the time since
+ * the process started, `cpu` its CPU usage since the previous
+ * scan, and `for` how long everything must have held before the
+ * signal is sent. Durations take s, m, h or d (default s). `#`
+ * starts a comment.
+ *
+ *   crashpad: cmd:=chrome_crashpad age>1h        -> TERM
+ *   java-hog: cmd:=java rss:>8G for 60s          -> KILL
+ *
+ * Each process is signalled at most once per rule, and every
+ * action is logged to stderr. The owners of `port:` terms are
+ * looked up again after a scan that finds new or gone processes,
+ * and at least every 10s otherwise. Each lookup reads every fd of
+ * every process, so rules with `port:` cost far more per scan than
+ * the others.
+ */
+
+// With `dry_run`, only logs what it would have sent.
+int watch_run(const char *rules_path, int dry_run);
+
+// "TERM", "SIGTERM" or a number, -1 for anything else.
+int watch_parse_signal(const char *s);
+// "SIGTERM", or "signal N" if it has no name.
+void watch_signal_name(char *buf, size_t n, int sig);
+
+#endif // WATCH_H_INCLUDED
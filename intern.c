@@ -0,0 +1,140 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+typedef struct {
+        uint64_t hash;
+        char *s;
+} entry;
+
+static struct {
+        entry *data;
+        size_t len, cap; // cap is a power of two
+} table = {0};
+
+// The background scanner interns cgroups too.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t
+fnv1a(const char *s,
+      size_t len)
+{
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < len; ++i) {
+                h ^= (unsigned char)s[i];
+                h *= 0x100000001b3ull;
+        }
+        return h;
+}
+
+// Leaves the table as it was if there is no memory for a
+// bigger one.
+static int
+grow(void)
+{
+        size_t cap = table.cap ? table.cap * 2 : 256;
+        entry *data = calloc(cap, sizeof(entry));
+        if (!data) return 0;
+
+        for (size_t i = 0; i < table.cap; ++i) {
+                if (!table.data[i].s) continue;
+                size_t j = table.data[i].hash & (cap - 1);
+                while (data[j].s) j = (j + 1) & (cap - 1);
+                data[j] = table.data[i];
+        }
+        free(table.data);
+        table.data = data;
+        table.cap = cap;
+        return 1;
+}
+
+static const char *
+intern_locked(const char *s,
+              size_t len)
+{
+        // Fuller than half only slows probing down, but there
+        // has to be an empty slot for it to stop at.
+        if ((table.len + 1) * 2 > table.cap && !grow() && table.len + 1 >= table.cap) {
+                return NULL;
+        }
+
+        uint64_t h = fnv1a(s, len);
+        size_t i = h & (table.cap - 1);
+        for (; table.data[i].s; i = (i + 1) & (table.cap - 1)) {
+                if (table.data[i].hash == h
+                    && !strncmp(table.data[i].s, s, len)
+                    && table.data[i].s[len] == '\0') {
+                        return table.data[i].s;
+                }
+        }
+
+        char *copy = malloc(len + 1);
+        if (!copy) return NULL;
+        memcpy(copy, s, len);
+        copy[len] = '\0';
+
+        table.data[i] = (entry) { .hash = h, .s = copy };
+        table.len++;
+        return copy;
+}
+
+const char *
+intern(const char *s,
+       size_t len)
+{
+        pthread_mutex_lock(&lock);
+        const char *res = intern_locked(s, len);
+        pthread_mutex_unlock(&lock);
+        return res;
+}
+
+static void
+clear_locked(void)
+{
+        for (size_t i = 0; i < table.cap; ++i) {
+                free(table.data[i].s);
+        }
+        free(table.data);
+        table.data = NULL;
+        table.len = table.cap = 0;
+}
+
+void
+intern_trim(size_t max)
+{
+        pthread_mutex_lock(&lock);
+        if (table.len > max) clear_locked();
+        pthread_mutex_unlock(&lock);
+}
+
+void
+intern_cleanup(void)
+{
+        pthread_mutex_lock(&lock);
+        clear_locked();
+        pthread_mutex_unlock(&lock);
+}
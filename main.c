@@ -18,20 +18,38 @@
 */
 
 #include <assert.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <dirent.h>
 #include <string.h>
-#include <pwd.h>
-#include <regex.h>
 #include <signal.h>
 #include <errno.h>
 #include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
 
 #include <ncurses.h>
 
 #include "flags.h"
 #include "dyn_array.h"
+#include "proc.h"
+#include "query.h"
+#include "trigram.h"
+#include "cgroup.h"
+#include "intern.h"
+#include "replay.h"
+#include "stats.h"
+#include "snapshot.h"
+#include "daemon.h"
+#include "table.h"
+#include "watch.h"
+#include "pressure.h"
+#include "term.h"
+#include "spawn.h"
+#include "smaps.h"
+#include "collapse.h"
 #define CLAP_IMPL
 #include "clap.h"
 
@@ -46,16 +64,44 @@
 #define ESCAPE 27
 #define ENTER 10
 #define SPACE 23
+#define TAB 9
+#define INLINE_ROWS 15
+#define SPAWN_REDRAW_MS 500
+#define SMAPS_PREFETCH 16 // rows read ahead above and below the screen
 
 DYN_ARRAY_TYPE(char, char_array);
 
+typedef enum {
+        VIEW_PROCS = 0,
+        VIEW_GROUPS,  // CTRL + g
+        VIEW_SPAWNS,  // CTRL + f
+        VIEW_COLLAPSED, // CTRL + d
+} view;
+
+typedef struct {
+        spawn_parent parent;
+        proc *p; // NULL if the parent is gone
+} spawn_row;
+
+DYN_ARRAY_TYPE(spawn_row, spawn_row_array);
+
 typedef struct {
-        char *user;
-        char *pid;
-        char *cmd;
-} proc;
+        size_t group; // in ctx->collapsed
+        proc *p;      // NULL for the row of the group itself
+} collapse_row;
 
-DYN_ARRAY_TYPE(proc *, proc_ptr_array);
+DYN_ARRAY_TYPE(collapse_row, collapse_row_array);
+DYN_ARRAY_TYPE(char *, str_array);
+
+// CPU time of a thread when its process was expanded
+typedef struct {
+        pid_t tid;
+        uint64_t start;
+        uint64_t ticks; // utime + stime
+        uint64_t at_ms;
+} thread_sample;
+
+DYN_ARRAY_TYPE(thread_sample, thread_sample_array);
 
 typedef struct {
         struct {
@@ -65,21 +111,74 @@ typedef struct {
         uint32_t flags;
         int selected;
         int scroll_offset;
-        proc_ptr_array procs;
+        proc_table *table; // pinned until the next table_acquire()
         proc_ptr_array filtered_procs;
         char_array input;
+        u32_array candidates;
+        view view;
+        proc_ptr_array group_members;
+        cgroup_group_array groups;
+        spawn_parent_array spawn_top;
+        spawn_row_array spawns;
+        collapse_group_array collapsed;
+        collapse_row_array collapse_rows;
+        str_array collapse_open; // "user\0cmd" of the expanded groups
+        replay *replay;
+        int show_stats; // live status line
+        int readonly;       // procs come from a snapshot file or --proc-root, not /proc
+        int inline_rows;    // draw this many rows below the prompt, 0: full screen
+        int smaps;          // show PSS, USS and swap of the visible rows
+        pid_array smaps_pids;
+        unsigned refresh_ms;
+        thread_sample_array thread_prev; // from the previous table, by tid
+        thread_sample_array thread_cur;  // from this one
 } context;
 
+// Only a real terminal was asked for focus reports
+static int focus_reports = 0;
+
 void
 cleanup(void)
 {
         endwin();
+        if (focus_reports) {
+                printf(TERM_FOCUS_OFF);
+                fflush(stdout);
+        }
+}
+
+void
+init_inline(context *ctx)
+{
+        int w, h;
+        if (term_open(ctx->inline_rows, ctx->replay != NULL, &w, &h) == -1) {
+                fprintf(stderr, "--%s: no terminal\n", FLAG_2HY_INLINE);
+                exit(1);
+        }
+        ctx->win.w = w;
+        ctx->win.h = h - 1; // Reserve one line for input
 }
 
 void
 init_ncurses(context *ctx)
 {
-        initscr();
+        if (ctx->replay) {
+                // Headless: draw everything, but into /dev/null
+                const char *term = getenv("TERM");
+                FILE *out = fopen("/dev/null", "w"), *in = fopen("/dev/null", "r");
+                if (!out || !in || !newterm(term && *term ? term : "xterm", out, in)) {
+                        fprintf(stderr, "could not create a virtual terminal\n");
+                        exit(1);
+                }
+        } else {
+                initscr();
+                // Refresh slower while the terminal is in the background
+                define_key("\x1b[I", KEY_FOCUS_IN);
+                define_key("\x1b[O", KEY_FOCUS_OUT);
+                printf(TERM_FOCUS_ON);
+                fflush(stdout);
+                focus_reports = 1;
+        }
         start_color();
         init_pair(1, COLOR_BLACK, COLOR_WHITE); // Highlight: black text, white background
         raw();
@@ -94,116 +193,326 @@ init_ncurses(context *ctx)
         ctx->win.h = max_y - 1; // Reserve one line for input
 }
 
-proc *
-get_process_info(const char *pid_str)
-{
-        proc *proc = malloc(sizeof(proc));
-        if (!proc) {
-                perror("malloc");
-                return NULL;
-        }
-
-        char path[256] = {0}, line[256] = {0};
-        FILE *status;
-        char cmd[256] = "N/A";
-        struct passwd *pw;
-        uid_t uid;
-        char *user = strdup("unknown");
-        char *pid = strdup(pid_str);
-
-        // Open /proc/[pid]/status
-        snprintf(path, sizeof(path), "/proc/%s/status", pid_str);
-        status = fopen(path, "r");
-        if (!status) {
-                free(user);
-                free(pid);
-                proc->user = NULL;
-                return NULL;
-        }
-
-        // Read process information
-        while (fgets(line, sizeof(line), status)) {
-                if (strncmp(line, "Name:", 5) == 0) {
-                        sscanf(line, "Name: %s", cmd);
-                } else if (strncmp(line, "Uid:", 4) == 0) {
-                        sscanf(line, "Uid: %u", &uid);
-                        pw = getpwuid(uid);
-                        if (pw) {
-                                free(user);
-                                user = strdup(pw->pw_name);
+uint64_t
+now_ms(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+int
+thread_sample_cmp(const void *a,
+                  const void *b)
+{
+        pid_t x = ((const thread_sample *)a)->tid, y = ((const thread_sample *)b)->tid;
+        return (x > y) - (x < y);
+}
+
+// The CPU usage of threads since they were last read, in an
+// earlier table. A lifetime average says little about a thread
+// that is spinning right now.
+void
+sample_threads(context *ctx,
+               proc *p)
+{
+        uint64_t now = now_ms();
+        for (size_t i = 0; i < p->threads.len; ++i) {
+                proc *t = p->threads.data[i];
+                thread_sample s = { .tid = t->pid, .start = t->start, .ticks = t->utime + t->stime, .at_ms = now };
+                const thread_sample *prev = bsearch(&s, ctx->thread_prev.data, ctx->thread_prev.len,
+                                                    sizeof(thread_sample), thread_sample_cmp);
+                if (prev && prev->start == s.start && prev->at_ms < now && prev->ticks <= s.ticks) {
+                        double dt = (double)(now - prev->at_ms) / 1000.0;
+                        t->recent_cpu = 100.0 * ((double)(s.ticks - prev->ticks) / proc_hz()) / dt;
+                }
+                dyn_array_append(ctx->thread_cur, s);
+        }
+}
+
+// Tells the refresher whose threads to load for its tables
+void
+want_threads(const context *ctx)
+{
+        pid_array pids = dyn_array_empty(pid_array);
+        for (size_t i = 0; i < ctx->table->procs.len; ++i) {
+                if (ctx->table->procs.data[i]->expanded) {
+                        dyn_array_append(pids, ctx->table->procs.data[i]->pid);
+                }
+        }
+        table_want_threads(pids.data, pids.len);
+        dyn_array_free(pids);
+}
+
+void
+add_filtered_proc(context *ctx,
+                  proc *p,
+                  int show_threads)
+{
+        dyn_array_append(ctx->filtered_procs, p);
+
+        // Threads of expanded processes go right below them. The
+        // refresher loads them for its tables, see want_threads().
+        if (!(p->expanded || show_threads)) return;
+        if (!(p->loaded & PF_THREADS)) {
+                if (!table_ready(ctx->table, PF_THREADS) || !proc_load(p, PF_THREADS)) return;
+                sample_threads(ctx, p);
+        }
+        for (size_t i = 0; i < p->threads.len; ++i) {
+                dyn_array_append(ctx->filtered_procs, p->threads.data[i]);
+        }
+}
+
+// What the refresher should load so that filtering and
+// grouping do not have to
+uint32_t
+wanted_fields(const context *ctx,
+              const query *q)
+{
+        uint32_t fields = q ? query_fields(q) : 0;
+        if (ctx->view == VIEW_GROUPS) fields |= PF_CGROUP | PF_STAT;
+        if (ctx->view == VIEW_COLLAPSED) fields |= PF_STAT;
+        return fields;
+}
+
+void
+filter_procs(context *ctx)
+{
+        // Compile the query once per keystroke
+        query *q = query_compile(ctx->input.data, ctx->input.len);
+        if (q) query_memoize(q); // the table is pinned for this pass
+        int threads = q && (query_fields(q) & PF_THREADS);
+        uint32_t fields = wanted_fields(ctx, q);
+        table_want_fields(fields);
+
+        // Nothing to show until the refresher loaded them
+        if (q && !table_ready(ctx->table, fields)) {
+                query_free(q);
+                return;
+        }
+
+        // Narrow down to candidates with the index if the
+        // query has a long enough literal
+        const char *lit = q ? query_literal(q) : NULL;
+        const proc_ptr_array *procs = &ctx->table->procs;
+        if (ctx->table->index && lit && trigram_candidates(ctx->table->index, lit, &ctx->candidates)) {
+                for (size_t i = 0; i < ctx->candidates.len; ++i) {
+                        proc *p = procs->data[ctx->candidates.data[i]];
+                        if (query_match(q, p)) {
+                                add_filtered_proc(ctx, p, threads);
+                        }
+                }
+        } else {
+                // Filter processes based on the query
+                for (size_t i = 0; q && i < procs->len; ++i) {
+                        if (query_match(q, procs->data[i])) {
+                                add_filtered_proc(ctx, procs->data[i], threads);
                         }
                 }
         }
-        fclose(status);
 
-        proc->user = user;
-        proc->pid = pid;
-        proc->cmd = strdup(cmd);
+        query_free(q);
+}
 
-        return proc;
+// Number of selectable rows in the current view
+int
+visible_len(const context *ctx)
+{
+        switch (ctx->view) {
+        case VIEW_GROUPS: return (int)ctx->groups.len;
+        case VIEW_SPAWNS: return (int)ctx->spawns.len;
+        case VIEW_COLLAPSED: return (int)ctx->collapse_rows.len;
+        default: return (int)ctx->filtered_procs.len;
+        }
 }
 
+// The user of a group, or its uid if the name is unknown
+const char *
+collapse_user(const collapse_group *g,
+              char *buf,
+              size_t n)
+{
+        if (g->user) return g->user;
+        snprintf(buf, n, "%u", (unsigned)g->uid);
+        return buf;
+}
+
+// Index of the group in ctx->collapse_open, or -1. Compared by
+// content, the strings of daemon tables move on each refresh.
 int
-regex(const char *pattern,
-      const char *s)
+collapse_find_open(const context *ctx,
+                   const collapse_group *g)
 {
-        regex_t regex;
-        int reti;
+        char uid[16];
+        const char *user = collapse_user(g, uid, sizeof(uid));
+        for (size_t i = 0; i < ctx->collapse_open.len; ++i) {
+                const char *key = ctx->collapse_open.data[i];
+                if (!strcmp(key, user) && !strcmp(key + strlen(key) + 1, g->cmd)) return (int)i;
+        }
+        return -1;
+}
 
-        reti = regcomp(&regex, pattern, REG_ICASE | REG_NOSUB);
-        if (reti) {
-                fprintf(stderr, "Could not compile regex\n");
-                return 0;
+// One row per group, followed by its members if expanded
+void
+update_collapse_rows(context *ctx)
+{
+        collapse_procs(&ctx->filtered_procs, ctx->table->uptime, &ctx->group_members, &ctx->collapsed);
+
+        ctx->collapse_rows.len = 0;
+        for (size_t i = 0; i < ctx->collapsed.len; ++i) {
+                const collapse_group *g = &ctx->collapsed.data[i];
+                dyn_array_append(ctx->collapse_rows, ((collapse_row) { i, NULL }));
+                if (collapse_find_open(ctx, g) == -1) continue;
+                for (size_t j = 0; j < g->count; ++j) {
+                        dyn_array_append(ctx->collapse_rows, ((collapse_row) { i, ctx->group_members.data[g->first + j] }));
+                }
+        }
+}
+
+void
+toggle_collapse_group(context *ctx)
+{
+        if (ctx->selected >= (int)ctx->collapse_rows.len) return;
+        size_t group = ctx->collapse_rows.data[ctx->selected].group;
+        const collapse_group *g = &ctx->collapsed.data[group];
+
+        int i = collapse_find_open(ctx, g);
+        if (i != -1) {
+                free(ctx->collapse_open.data[i]);
+                ctx->collapse_open.data[i] = ctx->collapse_open.data[--ctx->collapse_open.len];
+        } else {
+                char uid[16];
+                const char *user = collapse_user(g, uid, sizeof(uid));
+                size_t ulen = strlen(user), clen = strlen(g->cmd);
+                char *key = malloc(ulen + clen + 2);
+                if (!key) return;
+                memcpy(key, user, ulen + 1);
+                memcpy(key + ulen + 1, g->cmd, clen + 1);
+                dyn_array_append(ctx->collapse_open, key);
+        }
+
+        update_collapse_rows(ctx);
+
+        // Stay on the group when its members go away
+        for (size_t r = 0; r < ctx->collapse_rows.len; ++r) {
+                if (ctx->collapse_rows.data[r].group == group && !ctx->collapse_rows.data[r].p) {
+                        ctx->selected = (int)r;
+                        break;
+                }
+        }
+        if (ctx->selected < ctx->scroll_offset) ctx->scroll_offset = ctx->selected;
+}
+
+int
+spawn_row_by_pid(const void *a,
+                 const void *b)
+{
+        pid_t x = ((const spawn_row *)a)->parent.pid, y = ((const spawn_row *)b)->parent.pid;
+        return x < y ? -1 : x > y;
+}
+
+int
+spawn_row_by_rate(const void *a,
+                  const void *b)
+{
+        double x = ((const spawn_row *)a)->parent.rate, y = ((const spawn_row *)b)->parent.rate;
+        return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// The parents that spawned lately, matched up with their
+// procs in one pass over the table. Parents that are gone
+// only show up without a query.
+void
+update_spawns(context *ctx)
+{
+        pid_t selected = -1;
+        if (ctx->selected < (int)ctx->spawns.len) {
+                selected = ctx->spawns.data[ctx->selected].parent.pid;
+        }
+
+        spawn_top(&ctx->spawn_top);
+        ctx->spawns.len = 0;
+        for (size_t i = 0; i < ctx->spawn_top.len; ++i) {
+                spawn_row r = { ctx->spawn_top.data[i], NULL };
+                dyn_array_append(ctx->spawns, r);
+        }
+        qsort(ctx->spawns.data, ctx->spawns.len, sizeof(spawn_row), spawn_row_by_pid);
+
+        const proc_ptr_array *procs = &ctx->table->procs;
+        for (size_t i = 0; ctx->spawns.len && i < procs->len; ++i) {
+                spawn_row key = { .parent.pid = procs->data[i]->pid };
+                spawn_row *r = bsearch(&key, ctx->spawns.data, ctx->spawns.len, sizeof(spawn_row), spawn_row_by_pid);
+                if (r) r->p = procs->data[i];
+        }
+
+        query *q = ctx->input.len ? query_compile(ctx->input.data, ctx->input.len) : NULL;
+        if (q) query_memoize(q);
+        size_t w = 0;
+        for (size_t i = 0; i < ctx->spawns.len; ++i) {
+                spawn_row *r = &ctx->spawns.data[i];
+                if (ctx->input.len && !(q && r->p && table_ready(ctx->table, query_fields(q)) && query_match(q, r->p))) continue;
+                ctx->spawns.data[w++] = *r;
         }
+        ctx->spawns.len = w;
+        query_free(q);
 
-        reti = regexec(&regex, s, 0, NULL, 0);
-        regfree(&regex);
+        qsort(ctx->spawns.data, ctx->spawns.len, sizeof(spawn_row), spawn_row_by_rate);
 
-        return !reti;
+        // Stay on the same parent as the ranking changes
+        for (size_t i = 0; selected != -1 && i < ctx->spawns.len; ++i) {
+                if (ctx->spawns.data[i].parent.pid != selected) continue;
+                ctx->selected = (int)i;
+                if (ctx->selected < ctx->scroll_offset) {
+                        ctx->scroll_offset = ctx->selected;
+                } else if (ctx->selected >= ctx->scroll_offset + ctx->win.h - 1) {
+                        ctx->scroll_offset = ctx->selected - (ctx->win.h - 2);
+                }
+                break;
+        }
 }
 
 void
 update_filtered_procs(context *ctx)
 {
+        uint64_t t0 = STATS_BEGIN();
+
         // Clear existing filtered list
         ctx->filtered_procs.len = 0;
 
         // If input is empty, include all processes
         if (ctx->input.len == 0) {
-                for (size_t i = 0; i < ctx->procs.len; ++i) {
-                        dyn_array_append(ctx->filtered_procs, ctx->procs.data[i]);
+                uint32_t fields = wanted_fields(ctx, NULL);
+                table_want_fields(fields);
+                for (size_t i = 0; table_ready(ctx->table, fields) && i < ctx->table->procs.len; ++i) {
+                        add_filtered_proc(ctx, ctx->table->procs.data[i], 0);
                 }
-                return;
+        } else {
+                filter_procs(ctx);
         }
 
-        // Create regex string
-        char *pattern = malloc(ctx->input.len + 1);
-        if (!pattern) return;
-        memcpy(pattern, ctx->input.data, ctx->input.len);
-        pattern[ctx->input.len] = '\0';
-
-        // Filter processes based on cmd matching input
-        for (size_t i = 0; i < ctx->procs.len; ++i) {
-                const proc *p = ctx->procs.data[i];
-                if (regex(pattern, p->cmd) || regex(pattern, p->user) || regex(pattern, p->pid)) {
-                        dyn_array_append(ctx->filtered_procs, ctx->procs.data[i]);
-                }
+        if (ctx->view == VIEW_GROUPS) {
+                cgroup_group_procs(&ctx->filtered_procs, ctx->table->uptime, &ctx->group_members, &ctx->groups);
+        } else if (ctx->view == VIEW_SPAWNS) {
+                update_spawns(ctx);
+        } else if (ctx->view == VIEW_COLLAPSED) {
+                update_collapse_rows(ctx);
         }
 
-        free(pattern);
-
         // Adjust selection and scroll offset
-        if (ctx->filtered_procs.len == 0) {
+        int len = visible_len(ctx);
+        if (len == 0) {
                 ctx->selected = 0;
                 ctx->scroll_offset = 0;
-        } else if (ctx->selected >= (int)ctx->filtered_procs.len) {
-                ctx->selected = ctx->filtered_procs.len - 1;
+        } else if (ctx->selected >= len) {
+                ctx->selected = len - 1;
                 if (ctx->selected < ctx->scroll_offset) {
                         ctx->scroll_offset = ctx->selected;
                 } else if (ctx->selected >= ctx->scroll_offset + ctx->win.h - 1) {
                         ctx->scroll_offset = ctx->selected - (ctx->win.h - 2);
                 }
         }
+
+        STATS_END(ST_FILTER, t0);
 }
 
 int
@@ -220,77 +529,476 @@ iota(int forward)
         return res;
 }
 
+// One whole row, through ncurses or the --inline writer
+void
+ui_line(context *ctx,
+        int row,
+        int highlight,
+        const char *fmt,
+        ...)
+{
+        char buf[512];
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+
+        if (ctx->inline_rows) {
+                term_line(row, highlight, buf);
+                return;
+        }
+
+        move(row, 0);
+        clrtoeol();
+        if (highlight) attron(COLOR_PAIR(1));
+        mvaddnstr(row, 0, buf, ctx->win.w);
+        if (highlight) attroff(COLOR_PAIR(1));
+}
+
+void
+ui_present(context *ctx)
+{
+        if (ctx->inline_rows) {
+                term_flush();
+        } else {
+                wnoutrefresh(stdscr);
+                doupdate();
+        }
+}
+
+void
+ui_clear(context *ctx)
+{
+        if (ctx->inline_rows) {
+                term_invalidate();
+        } else {
+                clear();
+        }
+}
+
+int
+ui_getkey(context *ctx)
+{
+        if (ctx->replay) return replay_next_key(ctx->replay);
+
+        int ch = ctx->inline_rows ? term_getkey(100) : getch();
+        if (ch == KEY_FOCUS_IN || ch == KEY_FOCUS_OUT) {
+                table_note_focus(ch == KEY_FOCUS_IN);
+                return ERR;
+        }
+        if (ch != ERR) table_note_input();
+        return ch;
+}
+
+// What happened after ENTER. Inline, the area goes away and the
+// message is left in the terminal instead.
+void
+ui_result(context *ctx,
+          int ok,
+          const char *fmt,
+          ...)
+{
+        char buf[512];
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+
+        if (ctx->inline_rows) {
+                term_close();
+                printf("%s\n", buf);
+                return;
+        }
+
+        clear();
+        mvprintw(0, 0, "%s", buf);
+        wrefresh(stdscr);
+
+        if (ok) {
+                return;
+        } else {
+                printw("\nPress any key to continue...");
+        }
+
+        // Wait for a keypress to exit
+        timeout(-1);
+        getch();
+}
+
+// Asks on the input line before something that cannot be undone.
+// Only 'y' goes ahead.
+int
+ui_confirm(context *ctx,
+           const char *fmt,
+           ...)
+{
+        char buf[512];
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+
+        ui_line(ctx, ctx->win.h, 1, "%s [y/N]", buf);
+        ui_present(ctx);
+
+        int ch;
+        while ((ch = ui_getkey(ctx)) == ERR) {}
+        return ch == 'y' || ch == 'Y';
+}
+
+void
+format_bytes(char *buf,
+             size_t n,
+             uint64_t bytes)
+{
+        const char *units = "BKMGT";
+        double v = (double)bytes;
+        while (v >= 1024 && units[1]) {
+                v /= 1024;
+                ++units;
+        }
+        snprintf(buf, n, "%.1f%c", v, *units);
+}
+
+// Memory columns are only there with `smaps` and stay blank
+// for threads and until the worker has read the process.
+void
+format_proc_row(char *buf,
+                size_t n,
+                const proc *p,
+                double uptime,
+                int smaps)
+{
+        char mem[48] = "";
+        smaps_info m;
+        if (smaps && !p->thread && smaps_get(p->pid, &m)) {
+                char pss[12], uss[12], swap[12];
+                format_bytes(pss, sizeof(pss), m.pss);
+                format_bytes(uss, sizeof(uss), m.uss);
+                format_bytes(swap, sizeof(swap), m.swap);
+                snprintf(mem, sizeof(mem), "%7s %7s %7s ", pss, uss, swap);
+        } else if (smaps) {
+                snprintf(mem, sizeof(mem), "%7s %7s %7s ", "-", "-", "-");
+        }
+
+        if (p->thread) {
+                snprintf(buf, n, "%-8s %-8s %s `- %-16s %5.1f%%", p->user, p->pidstr, mem, p->cmd,
+                         p->recent_cpu >= 0 ? p->recent_cpu : proc_cpu_percent(p, uptime));
+        } else {
+                snprintf(buf, n, "%-8s %-8s %s%s", p->user, p->pidstr, mem, p->cmd);
+        }
+}
+
+// Asks for the memory of the rows on screen, then the ones
+// just below and above them in case the user scrolls.
+void
+want_smaps(context *ctx,
+           int rows)
+{
+        int len = (int)ctx->filtered_procs.len;
+        int first = ctx->scroll_offset, end = ctx->scroll_offset + rows;
+        int lo = first - SMAPS_PREFETCH, hi = end + SMAPS_PREFETCH;
+
+        ctx->smaps_pids.len = 0;
+        for (int pass = 0; pass < 3; ++pass) {
+                int from = pass == 0 ? first : pass == 1 ? end : lo;
+                int to = pass == 0 ? end : pass == 1 ? hi : first;
+                for (int i = from < 0 ? 0 : from; i < to && i < len; ++i) {
+                        const proc *p = ctx->filtered_procs.data[i];
+                        if (!p->thread) dyn_array_append(ctx->smaps_pids, p->pid);
+                }
+        }
+        smaps_want(ctx->smaps_pids.data, ctx->smaps_pids.len);
+}
+
+void
+format_group_row(char *buf,
+                 size_t n,
+                 const cgroup_group *g)
+{
+        char rss[16];
+        format_bytes(rss, sizeof(rss), g->rss);
+        snprintf(buf, n, "%-6zu %6.1f%% %8s %s", g->count, g->cpu, rss, g->path);
+}
+
+void
+format_collapse_row(char *buf,
+                    size_t n,
+                    const context *ctx,
+                    const collapse_row *r)
+{
+        char rss[16];
+        if (r->p) {
+                format_bytes(rss, sizeof(rss), r->p->rss);
+                snprintf(buf, n, "%-6s %6.1f%% %8s %-8s `- %s", "", proc_cpu_percent(r->p, ctx->table->uptime), rss, "", r->p->pidstr);
+        } else {
+                const collapse_group *g = &ctx->collapsed.data[r->group];
+                format_bytes(rss, sizeof(rss), g->rss);
+                char uid[16];
+                snprintf(buf, n, "%-6zu %6.1f%% %8s %-8s %s", g->count, g->cpu, rss,
+                         collapse_user(g, uid, sizeof(uid)), g->cmd);
+        }
+}
+
+void
+format_spawn_row(char *buf,
+                 size_t n,
+                 const spawn_row *r)
+{
+        if (r->p) {
+                snprintf(buf, n, "%8.1f %8u %-8s %-8s %s", r->parent.rate, r->parent.total,
+                         r->p->pidstr, r->p->user, r->p->cmd);
+        } else {
+                snprintf(buf, n, "%8.1f %8u %-8d %-8s %s", r->parent.rate, r->parent.total,
+                         (int)r->parent.pid, "-", "(exited)");
+        }
+}
+
 void
 dump_procs(context *ctx)
 {
+        uint64_t t0 = STATS_BEGIN();
         int max_rows = ctx->win.h; // Available rows for processes
 
-        mvprintw(0, 0, "%-8s %-8s %s", "USER", "PID", "COMMAND");
+        if (ctx->view == VIEW_GROUPS) {
+                ui_line(ctx, 0, 0, "%-6s %7s %8s %s", "PROCS", "CPU", "RSS", "CGROUP");
+        } else if (ctx->view == VIEW_SPAWNS) {
+                ui_line(ctx, 0, 0, "%8s %8s %-8s %-8s %s", "RATE/s", "SPAWNED", "PID", "USER", "COMMAND");
+        } else if (ctx->view == VIEW_COLLAPSED) {
+                ui_line(ctx, 0, 0, "%-6s %7s %8s %-8s %s", "PROCS", "CPU", "RSS", "USER", "COMMAND");
+        } else if (ctx->smaps) {
+                ui_line(ctx, 0, 0, "%-8s %-8s %7s %7s %7s %s", "USER", "PID", "PSS", "USS", "SWAP", "COMMAND");
+                want_smaps(ctx, max_rows - 1);
+        } else {
+                ui_line(ctx, 0, 0, "%-8s %-8s %s", "USER", "PID", "COMMAND");
+        }
 
-        // Clear process display area
+        // Filtered processes or their cgroups, and blank rows
+        // below them
         for (int row = 1; row < max_rows; row++) {
-                move(row, 0);
-                clrtoeol();
-        }
+                size_t i = ctx->scroll_offset + row - 1; // -1 for header
+                char line[512] = "";
 
-        // Calculate visible processes
-        size_t start = ctx->scroll_offset;
-        size_t end = start + max_rows - 1; // -1 for header
-        if (end > ctx->filtered_procs.len) end = ctx->filtered_procs.len;
+                if (i < (size_t)visible_len(ctx)) {
+                        if (ctx->view == VIEW_GROUPS) {
+                                format_group_row(line, sizeof(line), &ctx->groups.data[i]);
+                        } else if (ctx->view == VIEW_SPAWNS) {
+                                format_spawn_row(line, sizeof(line), &ctx->spawns.data[i]);
+                        } else if (ctx->view == VIEW_COLLAPSED) {
+                                format_collapse_row(line, sizeof(line), ctx, &ctx->collapse_rows.data[i]);
+                        } else {
+                                format_proc_row(line, sizeof(line), ctx->filtered_procs.data[i], ctx->table->uptime, ctx->smaps);
+                        }
+                }
+                ui_line(ctx, row, (int)i == ctx->selected && line[0], "%s", line);
+        }
 
-        // Filtered processes
-        for (size_t i = start; i < end; ++i) {
-                const proc *p = ctx->filtered_procs.data[i];
-                int row = i - start + 1; // +1 for header
+        ui_line(ctx, ctx->win.h, 0, "> %.*s_", (int)ctx->input.len, ctx->input.data);
 
-                if ((int)i == ctx->selected) {
-                        attron(COLOR_PAIR(1));
-                        mvprintw(row, 0, "%-8s %-8s %s", p->user, p->pid, p->cmd);
-                        attroff(COLOR_PAIR(1));
-                } else {
-                        mvprintw(row, 0, "%-8s %-8s %s", p->user, p->pid, p->cmd);
+        // Status line, below the input
+        if (ctx->show_stats) {
+                char line[256];
+                size_t len = 0;
+                if (table_refresh_interval()) {
+                        len = (size_t)snprintf(line, sizeof(line), "refresh %.1fs | ", table_refresh_interval() / 1000.0);
                 }
+                stats_status_line(line + len, sizeof(line) - len);
+                ui_line(ctx, ctx->win.h + 1, 0, "%.*s", ctx->win.w - 1, line);
         }
 
-        // Clear and redraw
-        move(ctx->win.h, 0);
-        clrtoeol();
-        mvprintw(ctx->win.h, 0, "> %.*s_", (int)ctx->input.len, ctx->input.data);
+        ui_present(ctx);
 
-        wnoutrefresh(stdscr);
-        doupdate();
+        STATS_END(ST_RENDER, t0);
+        stats_frame_end();
 }
 
 void
 kill_selected_proc(context *ctx)
 {
-        int ok = 1;
-
-        clear();
         if (ctx->filtered_procs.len > 0 && ctx->selected < (int)ctx->filtered_procs.len) {
                 const proc *p = ctx->filtered_procs.data[ctx->selected];
-                pid_t pid = atoi(p->pid);
-                if (kill(pid, SIGTERM) == 0) {
-                        mvprintw(0, 0, "Successfully sent SIGTERM to process %s (%s)", p->pid, p->cmd);
+                const char *what = p->thread ? "thread" : "process";
+                int res;
+
+                // Threads are signaled with tgkill(2) so a recycled
+                // tid in another process cannot be hit.
+                if (!p->thread) {
+                        res = kill(p->pid, SIGTERM);
+                } else {
+                        res = (int)syscall(SYS_tgkill, p->tgid, p->pid, SIGTERM);
+                }
+
+                if (res == 0) {
+                        ui_result(ctx, 1, "Successfully sent SIGTERM to %s %s (%s)", what, p->pidstr, p->cmd);
                 } else {
-                        mvprintw(0, 0, "Failed to send SIGTERM to process %s (%s): %s",
-                                 p->pid, p->cmd, strerror(errno));
-                        ok = 0;
+                        ui_result(ctx, 0, "Failed to send SIGTERM to %s %s (%s): %s",
+                                  what, p->pidstr, p->cmd, strerror(errno));
                 }
         } else {
-                mvprintw(0, 0, "No process selected");
+                ui_result(ctx, 1, "No process selected");
         }
-        wrefresh(stdscr);
+}
 
-        if (ok) {
-                return;
+// Returns 0 when the prompt was declined and nothing happened
+int
+kill_selected_group(context *ctx)
+{
+        if (ctx->selected < (int)ctx->groups.len) {
+                const cgroup_group *g = &ctx->groups.data[ctx->selected];
+                if (cgroup_is_protected(g->path)) {
+                        ui_result(ctx, 0, "Refusing to kill cgroup %s: it is the root cgroup or contains xkillr", g->path);
+                        return 1;
+                }
+                if (!ui_confirm(ctx, "Kill every process in cgroup %s?", g->path)) {
+                        return 0;
+                }
+                int res = cgroup_kill(g, &ctx->group_members);
+                if (res == 0) {
+                        ui_result(ctx, 1, "Successfully killed cgroup %s", g->path);
+                } else if (res > 0) {
+                        ui_result(ctx, 1, "Sent SIGKILL to %d processes in cgroup %s", res, g->path);
+                } else {
+                        ui_result(ctx, 0, "Failed to kill cgroup %s: %s", g->path, strerror(errno));
+                }
         } else {
-                printw("\nPress any key to continue...");
+                ui_result(ctx, 1, "No cgroup selected");
         }
+        return 1;
+}
 
-        // Wait for a keypress to exit
-        timeout(-1);
-        getch();
+// SIGTERM to the selected member, or to every member of the
+// selected group. Returns 0 when the prompt was declined and
+// nothing happened.
+int
+kill_selected_collapsed(context *ctx)
+{
+        if (ctx->selected >= (int)ctx->collapse_rows.len) {
+                ui_result(ctx, 1, "No process selected");
+                return 1;
+        }
+
+        const collapse_row *r = &ctx->collapse_rows.data[ctx->selected];
+        const collapse_group *g = &ctx->collapsed.data[r->group];
+        if (r->p) {
+                if (kill(r->p->pid, SIGTERM) == 0) {
+                        ui_result(ctx, 1, "Successfully sent SIGTERM to process %s (%s)", r->p->pidstr, r->p->cmd);
+                } else {
+                        ui_result(ctx, 0, "Failed to send SIGTERM to process %s (%s): %s",
+                                  r->p->pidstr, r->p->cmd, strerror(errno));
+                }
+                return 1;
+        }
+
+        char uid[16];
+        const char *user = collapse_user(g, uid, sizeof(uid));
+        if (!ui_confirm(ctx, "Send SIGTERM to %zu %s processes of %s?", g->count, g->cmd, user)) {
+                return 0;
+        }
+
+        size_t sent = 0;
+        int err = 0;
+        for (size_t i = 0; i < g->count; ++i) {
+                if (kill(ctx->group_members.data[g->first + i]->pid, SIGTERM) == 0) ++sent;
+                else err = errno;
+        }
+        if (sent == g->count) {
+                ui_result(ctx, 1, "Sent SIGTERM to %zu %s processes of %s", sent, g->cmd, user);
+        } else {
+                ui_result(ctx, 0, "Sent SIGTERM to %zu of %zu %s processes of %s: %s",
+                          sent, g->count, g->cmd, user, strerror(err));
+        }
+        return 1;
+}
+
+// Returns 0 when the prompt was declined and nothing happened
+int
+kill_selected_spawner(context *ctx)
+{
+        if (ctx->selected < (int)ctx->spawns.len) {
+                const spawn_row *r = &ctx->spawns.data[ctx->selected];
+                const char *cmd = r->p ? r->p->cmd : "exited";
+                if (!ui_confirm(ctx, "Stop and kill %d (%s) and everything under it?", (int)r->parent.pid, cmd)) {
+                        return 0;
+                }
+                int res = spawn_kill_tree(r->parent.pid);
+                if (res >= 0) {
+                        ui_result(ctx, 1, "Stopped and killed %d processes under %d (%s)", res, (int)r->parent.pid, cmd);
+                } else {
+                        ui_result(ctx, 0, "Failed to stop %d (%s): %s", (int)r->parent.pid, cmd, strerror(errno));
+                }
+        } else {
+                ui_result(ctx, 1, "No process selected");
+        }
+        return 1;
+}
+
+// Moves to the newest proc table, if there is one. Expanded
+// processes and the selected row are carried over by pid.
+int
+refresh_table(context *ctx)
+{
+        if (!table_newer(ctx->table)) {
+                return 0;
+        }
+
+        // Look at the old table before it can go away
+        pid_array expanded = dyn_array_empty(pid_array);
+        pid_t selected = -1;
+        for (size_t i = 0; i < ctx->table->procs.len; ++i) {
+                if (ctx->table->procs.data[i]->expanded) {
+                        dyn_array_append(expanded, ctx->table->procs.data[i]->pid);
+                }
+        }
+        if (ctx->view == VIEW_PROCS && ctx->selected < (int)ctx->filtered_procs.len) {
+                selected = ctx->filtered_procs.data[ctx->selected]->pid;
+        }
+
+        // Taking the table in counts against the refresh budget
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+
+        ctx->table = table_acquire();
+        spawn_observe(&ctx->table->procs);
+
+        // Threads read from the new table are compared to these
+        thread_sample_array samples = ctx->thread_prev;
+        ctx->thread_prev = ctx->thread_cur;
+        ctx->thread_cur = samples;
+        ctx->thread_cur.len = 0;
+        if (ctx->thread_prev.len > 1) {
+                qsort(ctx->thread_prev.data, ctx->thread_prev.len, sizeof(thread_sample), thread_sample_cmp);
+        }
+
+        for (size_t i = 0; expanded.len && i < ctx->table->procs.len; ++i) {
+                proc *p = ctx->table->procs.data[i];
+                for (size_t j = 0; j < expanded.len; ++j) {
+                        if (expanded.data[j] == p->pid) p->expanded = 1;
+                }
+        }
+        dyn_array_free(expanded);
+
+        // Threads the refresher loaded
+        for (size_t i = 0; i < ctx->table->procs.len; ++i) {
+                proc *p = ctx->table->procs.data[i];
+                if (!p->thread && (p->loaded & PF_THREADS)) sample_threads(ctx, p);
+        }
+
+        update_filtered_procs(ctx);
+
+        for (size_t i = 0; selected != -1 && i < ctx->filtered_procs.len; ++i) {
+                if (ctx->filtered_procs.data[i]->pid != selected) continue;
+                ctx->selected = (int)i;
+                if (ctx->selected < ctx->scroll_offset) {
+                        ctx->scroll_offset = ctx->selected;
+                } else if (ctx->selected >= ctx->scroll_offset + ctx->win.h - 1) {
+                        ctx->scroll_offset = ctx->selected - (ctx->win.h - 2);
+                }
+                break;
+        }
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+        table_charge((uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000 + (uint64_t)t1.tv_nsec - (uint64_t)t0.tv_nsec);
+        return 1;
 }
 
 void
@@ -299,21 +1007,46 @@ input_loop(context *ctx)
         int last_selected = -1;
         int last_scroll_offset = -1;
         size_t last_input_len = 0;
+        int dirty = 0;
+        uint64_t last_spawns = 0;
+        uint64_t last_smaps = smaps_generation();
 
         // Initial filter
         update_filtered_procs(ctx);
 
         while (1) {
+                if (refresh_table(ctx)) {
+                        dirty = 1;
+                }
+
+                // The worker read more of the visible rows
+                if (ctx->smaps && ctx->view == VIEW_PROCS && last_smaps != smaps_generation()) {
+                        last_smaps = smaps_generation();
+                        dirty = 1;
+                }
+
+                // Rates keep moving between tables
+                if (ctx->view == VIEW_SPAWNS && now_ms() - last_spawns >= SPAWN_REDRAW_MS) {
+                        update_filtered_procs(ctx);
+                        last_spawns = now_ms();
+                        dirty = 1;
+                }
+
                 // Redraw if selection, scroll offset, or input changed
                 if (last_selected != ctx->selected || last_scroll_offset != ctx->scroll_offset ||
-                    last_input_len != ctx->input.len) {
+                    last_input_len != ctx->input.len || dirty) {
                         dump_procs(ctx);
+                        dirty = 0;
                         last_selected = ctx->selected;
                         last_scroll_offset = ctx->scroll_offset;
                         last_input_len = ctx->input.len;
                 }
 
-                int ch = getch();
+                if (ctx->replay) {
+                        replay_key_done(ctx->replay);
+                }
+
+                int ch = ui_getkey(ctx);
                 if (ch == ERR) continue;
 
                 switch (ch) {
@@ -327,7 +1060,7 @@ input_loop(context *ctx)
                         }
                 } break;
                 case KEY_DOWN: {
-                        if (ctx->selected < (int)ctx->filtered_procs.len - 1) {
+                        if (ctx->selected < visible_len(ctx) - 1) {
                                 ctx->selected++;
                                 if (ctx->selected >= ctx->scroll_offset + ctx->win.h - 1) {
                                         ctx->scroll_offset++;
@@ -341,9 +1074,70 @@ input_loop(context *ctx)
                         }
                 } break;
                 case ENTER: {
-                        kill_selected_proc(ctx);
+                        // Never kill anything from a script, or
+                        // pids that are only in an old snapshot
+                        if (ctx->replay || ctx->readonly) break;
+                        if (ctx->view == VIEW_GROUPS) {
+                                if (!kill_selected_group(ctx)) break;
+                        } else if (ctx->view == VIEW_SPAWNS) {
+                                if (!kill_selected_spawner(ctx)) break;
+                        } else if (ctx->view == VIEW_COLLAPSED) {
+                                if (!kill_selected_collapsed(ctx)) break;
+                        } else {
+                                kill_selected_proc(ctx);
+                        }
                         return;
                 } break;
+                case CTRL('t'): {
+                        if (!stats_enabled) break;
+                        // The status line takes the last row
+                        ctx->show_stats = !ctx->show_stats;
+                        ctx->win.h += ctx->show_stats ? -1 : 1;
+                        if (ctx->selected >= ctx->scroll_offset + ctx->win.h - 1) {
+                                ctx->scroll_offset++;
+                        }
+                        ui_clear(ctx);
+                        dirty = 1;
+                } break;
+                case CTRL('g'): {
+                        ctx->view = ctx->view == VIEW_GROUPS ? VIEW_PROCS : VIEW_GROUPS;
+                        ctx->selected = ctx->scroll_offset = 0;
+                        update_filtered_procs(ctx);
+                        dirty = 1;
+                } break;
+                case CTRL('f'): {
+                        ctx->view = ctx->view == VIEW_SPAWNS ? VIEW_PROCS : VIEW_SPAWNS;
+                        ctx->selected = ctx->scroll_offset = 0;
+                        ctx->spawns.len = 0;
+                        update_filtered_procs(ctx);
+                        last_spawns = now_ms();
+                        dirty = 1;
+                } break;
+                case CTRL('d'): {
+                        ctx->view = ctx->view == VIEW_COLLAPSED ? VIEW_PROCS : VIEW_COLLAPSED;
+                        ctx->selected = ctx->scroll_offset = 0;
+                        update_filtered_procs(ctx);
+                        dirty = 1;
+                } break;
+                case TAB: {
+                        if (ctx->view == VIEW_COLLAPSED) {
+                                toggle_collapse_group(ctx);
+                                dirty = 1;
+                                break;
+                        }
+                        if (ctx->view != VIEW_PROCS || ctx->selected >= (int)ctx->filtered_procs.len) break;
+                        proc *p = ctx->filtered_procs.data[ctx->selected];
+                        if (!p->thread) {
+                                // Loaded here once, after that by the refresher
+                                p->expanded = !p->expanded;
+                                if (p->expanded && !(p->loaded & PF_THREADS) && proc_load(p, PF_THREADS)) {
+                                        sample_threads(ctx, p);
+                                }
+                                want_threads(ctx);
+                                update_filtered_procs(ctx);
+                                dirty = 1;
+                        }
+                } break;
                 default: {
                         if (ch >= 32 && ch <= 126) {
                                 dyn_array_append(ctx->input, (char)ch);
@@ -365,10 +1159,38 @@ main(int argc, char **argv)
                 .flags = 0x0000,
                 .selected = 0,
                 .scroll_offset = 0,
-                .procs = dyn_array_empty(proc_ptr_array),
+                .table = NULL,
                 .filtered_procs = dyn_array_empty(proc_ptr_array),
                 .input = dyn_array_empty(char_array),
+                .candidates = dyn_array_empty(u32_array),
+                .view = VIEW_PROCS,
+                .group_members = dyn_array_empty(proc_ptr_array),
+                .groups = dyn_array_empty(cgroup_group_array),
+                .spawn_top = dyn_array_empty(spawn_parent_array),
+                .spawns = dyn_array_empty(spawn_row_array),
+                .collapsed = dyn_array_empty(collapse_group_array),
+                .collapse_rows = dyn_array_empty(collapse_row_array),
+                .collapse_open = dyn_array_empty(str_array),
+                .replay = NULL,
+                .show_stats = 0,
+                .readonly = 0,
+                .inline_rows = 0,
+                .smaps = 0,
+                .smaps_pids = dyn_array_empty(pid_array),
+                .refresh_ms = 0, // --refresh turns the refresher on
+                .thread_prev = dyn_array_empty(thread_sample_array),
+                .thread_cur = dyn_array_empty(thread_sample_array),
         };
+        const char *stats_path = NULL;
+        const char *snapshot_out = NULL;
+        const char *snapshot_in = NULL;
+        const char *socket_path = NULL;
+        int run_daemon = 0;
+        const char *watch_rules = NULL;
+        int dry_run = 0;
+        int on_pressure = 0;
+        const char *pressure_trigger = NULL;
+        const char *pressure_rule = NULL;
 
         --argc, ++argv;
         clap_init(argc, argv);
@@ -398,6 +1220,115 @@ main(int argc, char **argv)
                         version();
                 } else if (two && !strcmp(arg.start, FLAG_2HY_CONTROLS)) {
                         controls();
+                } else if (two && !strcmp(arg.start, FLAG_2HY_INDEX)) {
+                        ctx.flags |= FT_INDEX;
+                } else if (two && !strcmp(arg.start, FLAG_2HY_PORT)) {
+                        char *port = clap_value(&arg);
+                        if (!port) {
+                                fprintf(stderr, "--%s: missing port\n", FLAG_2HY_PORT);
+                                exit(1);
+                        }
+                        // Same as typing `port:N` into the search box
+                        char term[64];
+                        snprintf(term, sizeof(term), "port:%s", port);
+                        query *check = strlen(port) < sizeof(term) - 5 ? query_compile_strict(term, strlen(term)) : NULL;
+                        if (!check) {
+                                fprintf(stderr, "--%s: bad port `%s`\n", FLAG_2HY_PORT, port);
+                                exit(1);
+                        }
+                        query_free(check);
+                        if (ctx.input.len) dyn_array_append(ctx.input, ' ');
+                        for (size_t i = 0; term[i]; ++i) dyn_array_append(ctx.input, term[i]);
+                } else if (two && !strcmp(arg.start, FLAG_2HY_SNAPSHOT_OUT)) {
+                        if (!(snapshot_out = clap_value(&arg))) {
+                                fprintf(stderr, "--%s: missing file\n", FLAG_2HY_SNAPSHOT_OUT);
+                                exit(1);
+                        }
+                } else if (two && !strcmp(arg.start, FLAG_2HY_SNAPSHOT_IN)) {
+                        if (!(snapshot_in = clap_value(&arg))) {
+                                fprintf(stderr, "--%s: missing file\n", FLAG_2HY_SNAPSHOT_IN);
+                                exit(1);
+                        }
+                } else if (two && !strcmp(arg.start, FLAG_2HY_STATS)) {
+                        stats_enabled = 1;
+                        stats_path = arg.eq;
+                } else if (two && !strcmp(arg.start, FLAG_2HY_REPLAY)) {
+                        char *path = clap_value(&arg);
+                        if (!path || !(ctx.replay = replay_load(path))) {
+                                fprintf(stderr, "--%s: %s\n", FLAG_2HY_REPLAY, path ? strerror(errno) : "missing file");
+                                exit(1);
+                        }
+                } else if (two && !strcmp(arg.start, FLAG_2HY_PROC_ROOT)) {
+                        char *dir = clap_value(&arg);
+                        if (!dir || proc_root_open(dir) == -1) {
+                                fprintf(stderr, "--%s: %s\n", FLAG_2HY_PROC_ROOT, dir ? strerror(errno) : "missing directory");
+                                exit(1);
+                        }
+                        // The daemon is looking at the real /proc, and
+                        // these pids are not real ones to signal: no
+                        // kills, and nothing that watches the live system
+                        ctx.flags |= FT_NO_DAEMON;
+                        ctx.readonly = 1;
+                        dry_run = 1;
+                } else if (two && !strcmp(arg.start, FLAG_2HY_CGROUP_ROOT)) {
+                        char *dir = clap_value(&arg);
+                        if (!dir || cgroup_root_open(dir) == -1) {
+                                fprintf(stderr, "--%s: %s\n", FLAG_2HY_CGROUP_ROOT, dir ? strerror(errno) : "missing directory");
+                                exit(1);
+                        }
+                } else if (two && !strcmp(arg.start, FLAG_2HY_READER)) {
+                        char *name = clap_value(&arg);
+                        int backend = name ? fileio_backend_from_name(name) : -1;
+                        if (backend == -1) {
+                                fprintf(stderr, "--%s: expected sync, threads or uring\n", FLAG_2HY_READER);
+                                exit(1);
+                        }
+                        proc_set_reader((fileio_backend)backend);
+                } else if (two && !strcmp(arg.start, FLAG_2HY_REFRESH)) {
+                        char *ms = clap_value(&arg);
+                        if (!ms) {
+                                fprintf(stderr, "--%s: missing interval\n", FLAG_2HY_REFRESH);
+                                exit(1);
+                        }
+                        ctx.refresh_ms = (unsigned)strtoul(ms, NULL, 10);
+                } else if (two && !strcmp(arg.start, FLAG_2HY_CPU_BUDGET)) {
+                        char *pct = clap_value(&arg), *end = NULL;
+                        double v = pct ? strtod(pct, &end) : -1;
+                        if (!pct || end == pct || (*end && strcmp(end, "%")) || v < 0 || v > 100) {
+                                fprintf(stderr, "--%s: expected a percentage of one CPU, e.g. 2%%\n", FLAG_2HY_CPU_BUDGET);
+                                exit(1);
+                        }
+                        table_set_cpu_budget(v / 100);
+                } else if (two && !strcmp(arg.start, FLAG_2HY_INLINE)) {
+                        ctx.inline_rows = arg.eq ? atoi(arg.eq) : INLINE_ROWS;
+                        if (ctx.inline_rows < 3) {
+                                fprintf(stderr, "--%s: need at least 3 rows\n", FLAG_2HY_INLINE);
+                                exit(1);
+                        }
+                } else if (two && !strcmp(arg.start, FLAG_2HY_WATCH)) {
+                        if (!(watch_rules = clap_value(&arg))) {
+                                fprintf(stderr, "--%s: missing file\n", FLAG_2HY_WATCH);
+                                exit(1);
+                        }
+                } else if (two && !strcmp(arg.start, FLAG_2HY_DRY_RUN)) {
+                        dry_run = 1;
+                } else if (two && !strcmp(arg.start, FLAG_2HY_ON_PRESSURE)) {
+                        on_pressure = 1;
+                        pressure_trigger = arg.eq;
+                } else if (two && !strcmp(arg.start, FLAG_2HY_PRESSURE_RULE)) {
+                        if (!(pressure_rule = clap_value(&arg))) {
+                                fprintf(stderr, "--%s: missing rule\n", FLAG_2HY_PRESSURE_RULE);
+                                exit(1);
+                        }
+                } else if (two && !strcmp(arg.start, FLAG_2HY_DAEMON)) {
+                        run_daemon = 1;
+                } else if (two && !strcmp(arg.start, FLAG_2HY_NO_DAEMON)) {
+                        ctx.flags |= FT_NO_DAEMON;
+                } else if (two && !strcmp(arg.start, FLAG_2HY_SOCKET)) {
+                        if (!(socket_path = clap_value(&arg))) {
+                                fprintf(stderr, "--%s: missing path\n", FLAG_2HY_SOCKET);
+                                exit(1);
+                        }
                 }
 
                 else if (arg.hyphc != 0) {
@@ -410,43 +1341,151 @@ main(int argc, char **argv)
                 }
         }
 
-        DIR *proc_dir;
-        struct dirent *entry;
+        if (!socket_path) {
+                socket_path = daemon_default_socket();
+        }
+
+        if (on_pressure) {
+                int res = pressure_run(pressure_trigger, pressure_rule, dry_run);
+                proc_cleanup();
+                intern_cleanup();
+                return res == -1;
+        }
+
+        if (watch_rules) {
+                int res = watch_run(watch_rules, dry_run);
+                proc_cleanup();
+                query_cleanup();
+                intern_cleanup();
+                return res == -1;
+        }
 
-        if (!(proc_dir = opendir("/proc"))) {
-                perror("opendir");
+        if (run_daemon) {
+                if (daemon_run(socket_path) == -1) {
+                        fprintf(stderr, "%s: %s\n", socket_path, strerror(errno));
+                        return 1;
+                }
+                proc_cleanup();
+                intern_cleanup();
+                return 0;
+        }
+
+        int table_fd = -1;
+        if (!snapshot_in && !(ctx.flags & FT_NO_DAEMON)) {
+                table_fd = daemon_attach(socket_path);
+        }
+
+        // Only the TUI searches enough to be worth an index
+        int index = (ctx.flags & FT_INDEX) && !(ctx.flags & FT_LIST) && !snapshot_out;
+        snapshot *snap = NULL;
+        proc_table *table = NULL;
+
+        uint64_t t0 = STATS_BEGIN();
+        if (table_fd != -1 && (snap = snapshot_open_fd(table_fd, 1))) {
+                table = table_from_snapshot(snap, PF_DEFAULT, index);
+        } else if (snapshot_in) {
+                if (!(snap = snapshot_open(snapshot_in))) {
+                        fprintf(stderr, "%s: %s\n", snapshot_in, strerror(errno));
+                        return 1;
+                }
+                table = table_from_snapshot(snap, PF_DEFAULT, index);
+                ctx.readonly = 1;
+        } else {
+                // A daemon that was there but sent nothing usable
+                table_fd = -1;
+                if (!(table = table_scan(PF_DEFAULT, index))) {
+                        perror("/proc");
+                        return 1;
+                }
+        }
+        STATS_END(ST_SCAN, t0);
+        if (table_fd != -1) close(table_fd);
+        if (!table) {
+                perror("table");
                 return 1;
         }
+        table_publish(table);
+        ctx.table = table_acquire();
 
-        while ((entry = readdir(proc_dir))) {
-                if (entry->d_type == DT_DIR
-                    && strspn(entry->d_name, "0123456789") == strlen(entry->d_name)) {
-                        proc *p = get_process_info(entry->d_name);
-                        if (p && p->user) {
-                                dyn_array_append(ctx.procs, p);
-                        }
+        if (snapshot_out) {
+                int fd = open(snapshot_out, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (fd == -1 || snapshot_write(fd, &ctx.table->procs, 0) == -1) {
+                        fprintf(stderr, "%s: %s\n", snapshot_out, strerror(errno));
+                        return 1;
+                }
+                close(fd);
+                if (!(ctx.flags & FT_LIST)) {
+                        ctx.flags |= FT_QUIT;
                 }
         }
 
-        if (ctx.flags & FT_LIST) {
+        if (ctx.flags & FT_QUIT) {
+                // Only asked for a snapshot
+        } else if (ctx.flags & FT_LIST) {
+                update_filtered_procs(&ctx);
                 printf("%-8s %-8s %s\n", "USER", "PID", "COMMAND");
-                for (size_t i = 0; i < ctx.procs.len; ++i) {
-                        const proc *p = ctx.procs.data[i];
-                        printf("%-8s %-8s %s\n", p->user, p->pid, p->cmd);
+                for (size_t i = 0; i < ctx.filtered_procs.len; ++i) {
+                        const proc *p = ctx.filtered_procs.data[i];
+                        printf("%-8s %-8s %s\n", p->user, p->pidstr, p->cmd);
                 }
         } else {
-                init_ncurses(&ctx);
-                atexit(cleanup);
+                // Scripted runs see one table, snapshot files never change
+                if (ctx.refresh_ms && !ctx.replay && !ctx.readonly) {
+                        table_refresher_start(ctx.refresh_ms, index, table_fd != -1 ? socket_path : NULL);
+                }
+                // Spawn rates only mean something for a live /proc
+                if (!ctx.replay && !ctx.readonly) {
+                        spawn_start();
+                        spawn_observe(&ctx.table->procs);
+                        ctx.smaps = smaps_start() == 0;
+                }
+                if (ctx.inline_rows) {
+                        init_inline(&ctx);
+                        atexit(term_close);
+                } else {
+                        init_ncurses(&ctx);
+                        atexit(cleanup);
+                }
                 input_loop(&ctx);
+                table_refresher_stop();
+                spawn_stop();
+                smaps_stop();
+                if (ctx.replay) {
+                        replay_report(ctx.replay, stderr);
+                        replay_free(ctx.replay);
+                }
         }
 
-        for (size_t i = 0; i < ctx.procs.len; ++i) {
-                free(ctx.procs.data[i]->user);
-                free(ctx.procs.data[i]->pid);
-                free(ctx.procs.data[i]->cmd);
-                free(ctx.procs.data[i]);
+        if (stats_enabled) {
+                FILE *out = stats_path ? fopen(stats_path, "w") : stderr;
+                if (!out) {
+                        perror(stats_path);
+                } else {
+                        stats_dump(out);
+                        if (out != stderr) fclose(out);
+                }
         }
-        dyn_array_free(ctx.procs);
+
+        table_cleanup();
+        dyn_array_free(ctx.filtered_procs);
+        dyn_array_free(ctx.input);
+        dyn_array_free(ctx.candidates);
+        dyn_array_free(ctx.group_members);
+        dyn_array_free(ctx.groups);
+        dyn_array_free(ctx.spawn_top);
+        dyn_array_free(ctx.spawns);
+        dyn_array_free(ctx.collapsed);
+        dyn_array_free(ctx.collapse_rows);
+        for (size_t i = 0; i < ctx.collapse_open.len; ++i) free(ctx.collapse_open.data[i]);
+        dyn_array_free(ctx.collapse_open);
+        dyn_array_free(ctx.smaps_pids);
+        dyn_array_free(ctx.thread_prev);
+        dyn_array_free(ctx.thread_cur);
+        proc_cleanup();
+        cgroup_cleanup();
+        collapse_cleanup();
+        query_cleanup();
+        intern_cleanup();
 
         return 0;
 }
@@ -0,0 +1,309 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "net.h"
+
+DYN_ARRAY_TYPE(unsigned long, inode_array);
+
+#define MAX_WORKERS 8
+
+typedef struct {
+        const pid_array *pids;
+        const inode_array *inodes;
+        atomic_size_t *next;      // next index into pids
+        atomic_size_t *remaining; // inodes without a known owner
+        atomic_uchar *found;      // per inode, NULL to scan every pid
+        atomic_uchar *scanned;    // per pid
+        pid_array owners;
+} worker;
+
+static const char *tables[] = {
+        "net/tcp", "net/tcp6", "net/udp", "net/udp6",
+};
+
+static int
+inode_cmp(const void *a,
+          const void *b)
+{
+        unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+        return x < y ? -1 : x > y;
+}
+
+static int
+pid_cmp(const void *a,
+        const void *b)
+{
+        pid_t x = *(const pid_t *)a, y = *(const pid_t *)b;
+        return x < y ? -1 : x > y;
+}
+
+// Collects the inodes of the sockets bound to [lo, hi].
+static int
+read_socket_tables(unsigned lo,
+                   unsigned hi,
+                   inode_array *out)
+{
+        int ok = 0;
+        char line[512];
+
+        for (size_t t = 0; t < sizeof(tables)/sizeof(*tables); ++t) {
+                int fd = openat(proc_root_fd(), tables[t], O_RDONLY | O_CLOEXEC);
+                if (fd == -1) continue;
+                FILE *f = fdopen(fd, "r");
+                if (!f) {
+                        close(fd);
+                        continue;
+                }
+                ok = 1;
+
+                // Skip the header.
+                if (!fgets(line, sizeof(line), f)) {
+                        fclose(f);
+                        continue;
+                }
+
+                while (fgets(line, sizeof(line), f)) {
+                        unsigned port;
+                        unsigned long inode;
+                        if (sscanf(line, " %*d: %*[0-9A-Fa-f]:%x %*[0-9A-Fa-f]:%*x %*x %*x:%*x %*x:%*x %*x %*u %*u %lu",
+                                   &port, &inode) != 2) {
+                                continue;
+                        }
+                        if (port >= lo && port <= hi && inode != 0) {
+                                dyn_array_append(*out, inode);
+                        }
+                }
+                fclose(f);
+        }
+
+        if (out->len > 1) {
+                qsort(out->data, out->len, sizeof(unsigned long), inode_cmp);
+        }
+
+        return ok ? 0 : -1;
+}
+
+static void
+scan_fds(worker *w,
+         pid_t pid)
+{
+        char path[32];
+        snprintf(path, sizeof(path), "%d/fd", (int)pid);
+
+        int fd = openat(proc_root_fd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) return; // exited, or not ours to look at
+        DIR *dir = fdopendir(fd);
+        if (!dir) {
+                close(fd);
+                return;
+        }
+
+        int owner = 0;
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+                char link[64];
+                ssize_t n = readlinkat(fd, entry->d_name, link, sizeof(link) - 1);
+                if (n <= 0) continue;
+                link[n] = '\0';
+
+                unsigned long inode;
+                if (sscanf(link, "socket:[%lu]", &inode) != 1) continue;
+
+                unsigned long *hit = bsearch(&inode, w->inodes->data, w->inodes->len,
+                                             sizeof(unsigned long), inode_cmp);
+                if (!hit) continue;
+
+                owner = 1;
+                if (!w->found) break;
+                if (!atomic_exchange(&w->found[hit - w->inodes->data], 1)) {
+                        atomic_fetch_sub(w->remaining, 1);
+                }
+        }
+        closedir(dir);
+
+        if (owner) {
+                dyn_array_append(w->owners, pid);
+        }
+}
+
+static void *
+worker_run(void *arg)
+{
+        worker *w = arg;
+        while (atomic_load(w->remaining) > 0) {
+                size_t i = atomic_fetch_add(w->next, 1);
+                if (i >= w->pids->len) break;
+                if (w->scanned) atomic_store(&w->scanned[i], 1);
+                scan_fds(w, w->pids->data[i]);
+        }
+        return NULL;
+}
+
+static pid_t
+parent_of(pid_t pid)
+{
+        proc *p = proc_get(pid, PF_STATUS);
+        if (!p) return -1;
+        pid_t ppid = p->ppid;
+        proc_free(p);
+        return ppid;
+}
+
+static int
+has_pid(const pid_array *a,
+        pid_t pid)
+{
+        return a->len && bsearch(&pid, a->data, a->len, sizeof(pid_t), pid_cmp);
+}
+
+// The workers stop once every socket has one owner, but a socket
+// inherited across fork(), e.g. by prefork workers, is held by a
+// whole family. Scan the skipped pids whose parent or child is a
+// known owner, until no new owner turns up. Sockets passed over
+// unix sockets to an unrelated process are not followed.
+static void
+scan_relatives(const pid_array *pids,
+               const inode_array *inodes,
+               const atomic_uchar *scanned,
+               pid_array *owners)
+{
+        pid_array ppids = dyn_array_empty(pid_array);   // per pid, -1 once scanned
+        pid_array parents = dyn_array_empty(pid_array); // of the owners
+        worker w = {
+                .inodes = inodes,
+                .owners = *owners,
+        };
+
+        for (size_t i = 0; i < pids->len; ++i) {
+                dyn_array_append(ppids, atomic_load(&scanned[i]) ? -1 : parent_of(pids->data[i]));
+        }
+
+        size_t known = 0;
+        for (;;) {
+                for (; known < w.owners.len; ++known) {
+                        dyn_array_append(parents, parent_of(w.owners.data[known]));
+                }
+                qsort(w.owners.data, w.owners.len, sizeof(pid_t), pid_cmp);
+                qsort(parents.data, parents.len, sizeof(pid_t), pid_cmp);
+
+                for (size_t i = 0; i < pids->len; ++i) {
+                        if (ppids.data[i] == -1) continue;
+                        if (!has_pid(&w.owners, ppids.data[i]) && !has_pid(&parents, pids->data[i])) continue;
+                        ppids.data[i] = -1;
+                        scan_fds(&w, pids->data[i]);
+                }
+                if (known == w.owners.len) break;
+        }
+
+        *owners = w.owners;
+        dyn_array_free(ppids);
+        dyn_array_free(parents);
+}
+
+int
+net_port_owners(unsigned lo,
+                unsigned hi,
+                pid_array *out)
+{
+        inode_array inodes = dyn_array_empty(inode_array);
+        pid_array pids = dyn_array_empty(pid_array);
+        int res = -1;
+
+        out->len = 0;
+
+        if (read_socket_tables(lo, hi, &inodes) == -1) {
+                goto done;
+        }
+        res = 0;
+
+        // Nothing is bound there, no need to look at any fds.
+        if (inodes.len == 0 || proc_pids(&pids) == -1) {
+                goto done;
+        }
+
+        atomic_size_t next = 0;
+        atomic_size_t remaining = inodes.len;
+        atomic_uchar *found = calloc(inodes.len, sizeof(*found));
+        atomic_uchar *scanned = calloc(pids.len, sizeof(*scanned));
+        if (!found || !scanned) {
+                // Without them there is no early stop, every pid is scanned.
+                free(found);
+                free(scanned);
+                found = scanned = NULL;
+        }
+
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t nworkers = ncpu > 0 ? (size_t)ncpu : 1;
+        if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+        if (nworkers > pids.len / 64 + 1) nworkers = pids.len / 64 + 1;
+
+        worker workers[MAX_WORKERS];
+        pthread_t threads[MAX_WORKERS];
+        for (size_t i = 0; i < nworkers; ++i) {
+                workers[i] = (worker) {
+                        .pids = &pids,
+                        .inodes = &inodes,
+                        .next = &next,
+                        .remaining = &remaining,
+                        .found = found,
+                        .scanned = scanned,
+                        .owners = dyn_array_empty(pid_array),
+                };
+        }
+
+        // Worker 0 runs on this thread.
+        size_t started = 1;
+        for (; started < nworkers; ++started) {
+                if (pthread_create(&threads[started], NULL, worker_run, &workers[started]) != 0) break;
+        }
+        worker_run(&workers[0]);
+
+        for (size_t i = 0; i < nworkers; ++i) {
+                if (i > 0 && i < started) pthread_join(threads[i], NULL);
+                for (size_t j = 0; j < workers[i].owners.len; ++j) {
+                        dyn_array_append(*out, workers[i].owners.data[j]);
+                }
+                dyn_array_free(workers[i].owners);
+        }
+        if (scanned && atomic_load(&next) < pids.len) {
+                scan_relatives(&pids, &inodes, scanned, out);
+        }
+        free(found);
+        free(scanned);
+
+        if (out->len > 1) {
+                qsort(out->data, out->len, sizeof(pid_t), pid_cmp);
+        }
+
+done:
+        dyn_array_free(inodes);
+        dyn_array_free(pids);
+        return res;
+}
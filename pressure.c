@@ -0,0 +1,505 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pressure.h"
+#include "proc.h"
+#include "query.h"
+#include "watch.h"
+
+#define PRESSURE_PATH "/proc/pressure/memory"
+#define DEFAULT_TRIGGER "some 150000 1000000"
+// Unprivileged triggers need a window that is a multiple of 2s.
+#define UNPRIVILEGED_TRIGGER "some 300000 2000000"
+
+#define TOP 10
+
+typedef struct {
+        pid_t pid;
+        pid_t ppid;
+        uid_t uid;
+        uint64_t rss;   // bytes
+        uint64_t start; // clock ticks since boot
+        char cmd[32];
+} entry;
+
+// What getdents64 fills in.
+struct raw_dirent {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+};
+
+// Everything an event touches. Static, so it is all there (and
+// locked with the rest of the process) before the first one.
+static struct {
+        int dirfd;
+        int psi;
+        query *rule;
+        int sig;
+        int dry_run;
+        long page_size;
+
+        entry top[TOP]; // min-heap on rss
+        size_t ntop;
+        entry best;     // the largest match of the rule
+        int have_best;
+        size_t scanned;
+
+        char dents[32 * 1024];
+        char file[4096];
+        char out[8192];
+        size_t outlen;
+} ps;
+
+static volatile sig_atomic_t stop = 0;
+static volatile sig_atomic_t forced = 0;
+
+static void
+on_signal(int sig)
+{
+        if (sig == SIGUSR1) forced = 1;
+        else stop = 1;
+}
+
+static void
+out(const char *fmt,
+    ...)
+{
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(ps.out + ps.outlen, sizeof(ps.out) - ps.outlen, fmt, ap);
+        va_end(ap);
+        if (n > 0) {
+                ps.outlen += (size_t)n;
+                if (ps.outlen >= sizeof(ps.out)) ps.outlen = sizeof(ps.out) - 1;
+        }
+}
+
+static void
+flush_out(void)
+{
+        size_t off = 0;
+        while (off < ps.outlen) {
+                ssize_t n = write(STDOUT_FILENO, ps.out + off, ps.outlen - off);
+                if (n <= 0) break;
+                off += (size_t)n;
+        }
+        ps.outlen = 0;
+}
+
+// Reads `<pid>/<name>` into ps.file.
+static ssize_t
+read_pid_file(const char *pid,
+              const char *name)
+{
+        char path[64];
+        snprintf(path, sizeof(path), "%s/%s", pid, name);
+
+        int fd = openat(ps.dirfd, path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return -1;
+        ssize_t n = read(fd, ps.file, sizeof(ps.file) - 1);
+        close(fd);
+        if (n < 0) return -1;
+        ps.file[n] = '\0';
+        return n;
+}
+
+// pid, cmd, ppid, start and rss all come from `stat`. The uid
+// is only read when the rule might look at it.
+static int
+read_entry(const char *pid,
+           entry *e)
+{
+        if (read_pid_file(pid, "stat") <= 0) return 0;
+
+        char *lp = strchr(ps.file, '('), *rp = strrchr(ps.file, ')');
+        if (!lp || !rp || rp < lp) return 0;
+
+        memset(e, 0, sizeof(*e));
+        e->pid = (pid_t)strtol(ps.file, NULL, 10);
+        size_t n = (size_t)(rp - lp - 1);
+        if (n >= sizeof(e->cmd)) n = sizeof(e->cmd) - 1;
+        memcpy(e->cmd, lp + 1, n);
+
+        char *s = rp + 2;
+        for (int field = 3; *s && field <= 24; ++field) {
+                if (field == 4) e->ppid = (pid_t)strtol(s, NULL, 10);
+                else if (field == 22) e->start = strtoull(s, NULL, 10);
+                else if (field == 24) e->rss = strtoull(s, NULL, 10) * (uint64_t)ps.page_size;
+                while (*s && *s != ' ') ++s;
+                while (*s == ' ') ++s;
+        }
+
+        if (ps.rule && read_pid_file(pid, "status") > 0) {
+                char *uid = strstr(ps.file, "\nUid:");
+                if (uid) e->uid = (uid_t)strtoul(uid + 5, NULL, 10);
+        }
+        return 1;
+}
+
+static void
+sift_down(size_t i)
+{
+        for (;;) {
+                size_t l = 2 * i + 1, r = l + 1, m = i;
+                if (l < ps.ntop && ps.top[l].rss < ps.top[m].rss) m = l;
+                if (r < ps.ntop && ps.top[r].rss < ps.top[m].rss) m = r;
+                if (m == i) return;
+                entry t = ps.top[i];
+                ps.top[i] = ps.top[m];
+                ps.top[m] = t;
+                i = m;
+        }
+}
+
+static void
+push_top(const entry *e)
+{
+        if (ps.ntop < TOP) {
+                size_t i = ps.ntop++;
+                ps.top[i] = *e;
+                while (i > 0 && ps.top[(i - 1) / 2].rss > ps.top[i].rss) {
+                        entry t = ps.top[i];
+                        ps.top[i] = ps.top[(i - 1) / 2];
+                        ps.top[(i - 1) / 2] = t;
+                        i = (i - 1) / 2;
+                }
+        } else if (e->rss > ps.top[0].rss) {
+                ps.top[0] = *e;
+                sift_down(0);
+        }
+}
+
+static int
+rule_matches(const entry *e)
+{
+        proc p;
+        memset(&p, 0, sizeof(p));
+        p.loaded = PF_STATUS | PF_STAT;
+        p.pid = p.tgid = e->pid;
+        snprintf(p.pidstr, sizeof(p.pidstr), "%d", e->pid);
+        p.ppid = e->ppid;
+        p.uid = e->uid;
+        p.rss = e->rss;
+        p.start = e->start;
+        p.cmd = e->cmd;
+        return query_match(ps.rule, &p);
+}
+
+static void
+scan(void)
+{
+        ps.ntop = 0;
+        ps.have_best = 0;
+        ps.scanned = 0;
+
+        if (lseek(ps.dirfd, 0, SEEK_SET) == -1) return;
+
+        long n;
+        while ((n = syscall(SYS_getdents64, ps.dirfd, ps.dents, sizeof(ps.dents))) > 0) {
+                for (long off = 0; off < n; ) {
+                        const struct raw_dirent *de = (const struct raw_dirent *)(ps.dents + off);
+                        off += de->d_reclen;
+
+                        const char *c = de->d_name;
+                        while (*c >= '0' && *c <= '9') ++c;
+                        if (c == de->d_name || *c) continue;
+
+                        entry e;
+                        if (!read_entry(de->d_name, &e)) continue;
+                        ps.scanned++;
+
+                        // Kernel threads have no memory of their own.
+                        if (e.rss == 0) continue;
+                        push_top(&e);
+                        if (ps.rule && (!ps.have_best || e.rss > ps.best.rss) && rule_matches(&e)) {
+                                ps.best = e;
+                                ps.have_best = 1;
+                        }
+                }
+        }
+}
+
+// Like watch.c, only signals `e` if it is still the process that
+// was scanned, but without allocating.
+static int
+send_signal(const entry *e,
+            int sig)
+{
+        int pidfd = -1;
+#ifdef SYS_pidfd_open
+        pidfd = (int)syscall(SYS_pidfd_open, e->pid, 0);
+        if (pidfd == -1 && errno != ENOSYS) return -1;
+#endif
+
+        char pid[12];
+        entry now;
+        snprintf(pid, sizeof(pid), "%d", e->pid);
+        int same = read_entry(pid, &now) && now.start == e->start;
+
+        int res = -1;
+        if (!same) {
+                errno = ESRCH;
+        } else if (pidfd != -1) {
+#ifdef SYS_pidfd_send_signal
+                res = (int)syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+#endif
+        } else {
+                res = kill(e->pid, sig);
+        }
+
+        if (pidfd != -1) {
+                int err = errno;
+                close(pidfd);
+                errno = err;
+        }
+        return res;
+}
+
+static double
+mib(uint64_t bytes)
+{
+        return (double)bytes / (1024 * 1024);
+}
+
+static double
+elapsed_ms(const struct timespec *t0)
+{
+        struct timespec t1;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        return (double)(t1.tv_sec - t0->tv_sec) * 1e3 + (double)(t1.tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+static void
+on_event(const char *why)
+{
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        scan();
+        double ms = elapsed_ms(&t0);
+
+        char when[32];
+        struct tm tm;
+        time_t t = time(NULL);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm));
+
+        out("%s memory pressure (%s)\n", when, why);
+
+        // The averages as the kernel sees them right now.
+        ssize_t n = pread(ps.psi, ps.file, sizeof(ps.file) - 1, 0);
+        ps.file[n > 0 ? n : 0] = '\0';
+        for (char *line = ps.file, *nl; *line; line = nl + 1) {
+                if (!(nl = strchr(line, '\n'))) nl = line + strlen(line) - 1;
+                out("  %.*s\n", (int)(nl - line + (*nl != '\n')), line);
+        }
+
+        out("scanned %zu processes in %.1fms\n", ps.scanned, ms);
+        out("  %-8s %-8s %10s  %s\n", "PID", "PPID", "RSS", "COMMAND");
+
+        // Largest first. The heap is at most TOP long.
+        for (size_t i = 1; i < ps.ntop; ++i) {
+                entry e = ps.top[i];
+                size_t j = i;
+                for (; j > 0 && ps.top[j - 1].rss < e.rss; --j) ps.top[j] = ps.top[j - 1];
+                ps.top[j] = e;
+        }
+        for (size_t i = 0; i < ps.ntop; ++i) {
+                const entry *e = &ps.top[i];
+                out("  %-8d %-8d %9.1fM  %s\n", e->pid, e->ppid, mib(e->rss), e->cmd);
+        }
+
+        if (ps.rule) {
+                char sig[16];
+                watch_signal_name(sig, sizeof(sig), ps.sig);
+                if (!ps.have_best) {
+                        out("no process matches the rule\n");
+                } else if (ps.dry_run) {
+                        out("would send %s to %d %s (rss %.1fM)\n", sig, ps.best.pid, ps.best.cmd, mib(ps.best.rss));
+                } else if (send_signal(&ps.best, ps.sig) == -1) {
+                        out("failed to send %s to %d %s: %s\n", sig, ps.best.pid, ps.best.cmd, strerror(errno));
+                } else {
+                        out("sent %s to %d %s (rss %.1fM)\n", sig, ps.best.pid, ps.best.cmd, mib(ps.best.rss));
+                }
+        }
+        out("\n");
+        flush_out();
+}
+
+static const char *
+parse_rule(const char *src)
+{
+        const char *arrow = strstr(src, "->");
+        if (!arrow) return "expected TERMS -> SIGNAL";
+
+        const char *sig = arrow + 2;
+        while (*sig == ' ' || *sig == '\t') ++sig;
+        char name[16];
+        size_t n = strcspn(sig, " \t");
+        if (n == 0 || n >= sizeof(name) || sig[n + strspn(sig + n, " \t")]) return "expected one signal after `->`";
+        memcpy(name, sig, n);
+        name[n] = '\0';
+        if ((ps.sig = watch_parse_signal(name)) == -1) return "unknown signal";
+
+        if (!(ps.rule = query_compile_strict(src, (size_t)(arrow - src)))) return "bad search terms";
+        if (query_fields(ps.rule) & ~(uint32_t)PF_STATUS) {
+                return "only pid, ppid, uid, rss and cmd can be used (plain words also match the user)";
+        }
+        // Owners would be from startup, and finding them again
+        // means reading every fd of every process mid event.
+        if (query_uses_port(ps.rule)) return "port cannot be used, its owners change";
+        // Nothing may be allocated once memory is short
+        if (!query_prebuild(ps.rule)) return "regex must be buildable up front (no {n,m}, back-references or huge patterns)";
+        return NULL;
+}
+
+static int
+open_trigger(const char *trigger)
+{
+        int fd = open(PRESSURE_PATH, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd == -1) return -1;
+        // The kernel wants the terminating NUL too.
+        if (write(fd, trigger, strlen(trigger) + 1) == -1) {
+                int err = errno;
+                close(fd);
+                errno = err;
+                return -1;
+        }
+        return fd;
+}
+
+int
+pressure_run(const char *trigger,
+             const char *rule,
+             int dry_run)
+{
+        int explicit = trigger != NULL;
+        if (!trigger) trigger = DEFAULT_TRIGGER;
+
+        memset(&ps, 0, sizeof(ps));
+        ps.dry_run = dry_run;
+        ps.page_size = sysconf(_SC_PAGESIZE);
+
+        if (rule) {
+                const char *err = parse_rule(rule);
+                if (err) {
+                        fprintf(stderr, "--on-pressure: `%s`: %s\n", rule, err);
+                        query_free(ps.rule);
+                        return -1;
+                }
+        }
+
+        ps.psi = open_trigger(trigger);
+        if (ps.psi == -1 && errno == EINVAL && !explicit) {
+                trigger = UNPRIVILEGED_TRIGGER;
+                ps.psi = open_trigger(trigger);
+        }
+        if (ps.psi == -1) {
+                fprintf(stderr, "--on-pressure: %s: `%s`: %s%s\n", PRESSURE_PATH, trigger, strerror(errno),
+                        errno == ENOENT ? " (kernel without PSI?)"
+                        : errno == EINVAL ? " (unprivileged triggers need a window that is a multiple of 2s)"
+                        : "");
+                query_free(ps.rule);
+                return -1;
+        }
+
+        if (proc_root_fd() == -1
+            || (ps.dirfd = openat(proc_root_fd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1) {
+                perror("--on-pressure: proc root");
+                close(ps.psi);
+                query_free(ps.rule);
+                return -1;
+        }
+
+        // A first scan, so that everything it touches (stdio's
+        // formatting, the timezone, the rule's regex DFA) is set
+        // up before memory is tight, then pin all of it.
+        scan();
+        struct tm tm;
+        time_t t = time(NULL);
+        localtime_r(&t, &tm);
+        int locked = mlockall(MCL_CURRENT) == 0;
+
+        fprintf(stderr, "waiting for memory pressure (%s)%s%s%s%s\n", trigger,
+                rule ? ", then " : "", rule ? rule : "", dry_run ? " (dry run)" : "",
+                locked ? "" : ", memory not locked");
+
+        // Blocked except while in ppoll(), so none is lost
+        // between checking the flags and going to sleep.
+        sigset_t block, old;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        sigaddset(&block, SIGTERM);
+        sigaddset(&block, SIGUSR1);
+        sigprocmask(SIG_BLOCK, &block, &old);
+
+        struct sigaction sa = {0};
+        sa.sa_handler = on_signal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        sigaction(SIGUSR1, &sa, NULL);
+
+        int res = 0;
+        struct pollfd pfd = { .fd = ps.psi, .events = POLLPRI };
+        while (!stop) {
+                if (forced) {
+                        forced = 0;
+                        on_event("SIGUSR1");
+                        continue;
+                }
+                if (ppoll(&pfd, 1, NULL, &old) == -1) {
+                        if (errno == EINTR) continue;
+                        perror("--on-pressure: poll");
+                        res = -1;
+                        break;
+                }
+                if (pfd.revents & POLLERR) {
+                        fprintf(stderr, "--on-pressure: %s went away\n", PRESSURE_PATH);
+                        res = -1;
+                        break;
+                }
+                if (pfd.revents & POLLPRI) {
+                        on_event(trigger);
+                }
+        }
+
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        if (locked) munlockall();
+        close(ps.dirfd);
+        close(ps.psi);
+        query_free(ps.rule);
+        return res;
+}
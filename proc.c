@@ -0,0 +1,603 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "proc.h"
+#include "fileio.h"
+#include "intern.h"
+#include "stats.h"
+
+typedef struct uid_entry {
+        uid_t uid;
+        char *name;
+        struct uid_entry *next;
+} uid_entry;
+
+// Only a handful of distinct users own processes on a box,
+// so a linear cache beats calling getpwuid() per process.
+// Entries are only ever pushed to the front, so lookups need
+// no lock while the background scanner adds to it.
+static _Atomic(uid_entry *) uid_cache = NULL;
+static pthread_mutex_t uid_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int proc_dirfd = -1;
+
+// How proc_scan() reads the per process files. Anything but
+// FIO_SYNC reads SCAN_BATCH processes at a time.
+static fileio_backend scan_reader = FIO_SYNC;
+
+#define SCAN_BATCH 256
+
+int
+proc_root_open(const char *path)
+{
+        int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+                return -1;
+        }
+        if (proc_dirfd != -1) {
+                close(proc_dirfd);
+        }
+        proc_dirfd = fd;
+        return 0;
+}
+
+static const char *
+uid_cached(uid_t uid)
+{
+        for (uid_entry *e = atomic_load_explicit(&uid_cache, memory_order_acquire); e; e = e->next) {
+                if (e->uid == uid) {
+                        return e->name;
+                }
+        }
+        return NULL;
+}
+
+static const char *
+uid_to_user(uid_t uid)
+{
+        const char *name = uid_cached(uid);
+        if (name) {
+                return name;
+        }
+
+        pthread_mutex_lock(&uid_cache_lock);
+        if ((name = uid_cached(uid))) {
+                pthread_mutex_unlock(&uid_cache_lock);
+                return name;
+        }
+
+        uint64_t t0 = STATS_BEGIN();
+        struct passwd *pw = getpwuid(uid);
+        STATS_END(ST_GETPWUID, t0);
+
+        uid_entry *e = calloc(1, sizeof(*e));
+        if (e) {
+                if (pw) {
+                        e->name = strdup(pw->pw_name);
+                } else {
+                        char buf[16];
+                        snprintf(buf, sizeof(buf), "%u", (unsigned)uid);
+                        e->name = strdup(buf);
+                }
+                e->uid = uid;
+                e->next = atomic_load_explicit(&uid_cache, memory_order_relaxed);
+                atomic_store_explicit(&uid_cache, e, memory_order_release);
+                name = e->name;
+        }
+        pthread_mutex_unlock(&uid_cache_lock);
+        return name;
+}
+
+// Read `<pid>/<file>` relative to the proc root into `buf`.
+// Returns the number of bytes read (NUL terminated), or -1.
+static ssize_t
+read_pid_file(const char *dir,
+              const char *file,
+              char *buf,
+              size_t cap)
+{
+        char path[64];
+        snprintf(path, sizeof(path), "%s/%s", dir, file);
+
+        file_read r = { .path = path, .buf = buf, .cap = cap };
+        size_t calls = fileio_read(FIO_SYNC, proc_dirfd, &r, 1);
+        STATS_SYSCALLS(calls);
+        return r.len;
+}
+
+static int
+parse_status(proc *p,
+             char *buf,
+             size_t n)
+{
+        (void)n;
+        char *cmd = NULL;
+        p->rss = 0;
+
+        for (char *line = buf; line && *line; ) {
+                char *nl = strchr(line, '\n');
+                if (nl) *nl = '\0';
+
+                if (!strncmp(line, "Name:", 5)) {
+                        line += 5;
+                        while (*line == ' ' || *line == '\t') ++line;
+                        cmd = line;
+                } else if (!strncmp(line, "PPid:", 5)) {
+                        p->ppid = (pid_t)strtol(line + 5, NULL, 10);
+                } else if (!strncmp(line, "Uid:", 4)) {
+                        p->uid = (uid_t)strtoul(line + 4, NULL, 10);
+                } else if (!strncmp(line, "VmRSS:", 6)) {
+                        p->rss = strtoull(line + 6, NULL, 10) * 1024;
+                }
+
+                line = nl ? nl + 1 : NULL;
+        }
+
+        // Hundreds of workers share a handful of names, and
+        // equal names get equal pointers to group and match by
+        p->cmd = cmd ? intern(cmd, strlen(cmd)) : intern("N/A", 3);
+        return p->cmd != NULL;
+}
+
+static int
+parse_stat(proc *p,
+           char *buf,
+           size_t n)
+{
+        (void)n;
+        // The command name may contain spaces and parens, so
+        // start parsing after the last ')'.
+        char *s = strrchr(buf, ')');
+        if (!s) return 0;
+        s += 2; // ") "
+
+        // s now points at field 3 (state).
+        for (int field = 3; *s && field <= 22; ++field) {
+                if (field == 14) p->utime = strtoull(s, NULL, 10);
+                else if (field == 15) p->stime = strtoull(s, NULL, 10);
+                else if (field == 22) p->start = strtoull(s, NULL, 10);
+                while (*s && *s != ' ') ++s;
+                while (*s == ' ') ++s;
+        }
+        return 1;
+}
+
+static int
+parse_cmdline(proc *p,
+              char *buf,
+              size_t n)
+{
+        // Arguments are NUL separated.
+        for (size_t i = 0; i < n; ++i) {
+                if (buf[i] == '\0') buf[i] = ' ';
+        }
+        while (n > 0 && buf[n-1] == ' ') buf[--n] = '\0';
+
+        p->args = strdup(n > 0 ? buf : p->cmd ? p->cmd : "");
+        return 1;
+}
+
+static proc *
+proc_new(pid_t tgid,
+         const char *pidstr)
+{
+        proc *p = calloc(1, sizeof(*p));
+        if (!p) {
+                perror("calloc");
+                return NULL;
+        }
+
+        snprintf(p->pidstr, sizeof(p->pidstr), "%s", pidstr);
+        p->pid = (pid_t)atoi(pidstr);
+        p->tgid = tgid ? tgid : p->pid;
+        p->thread = tgid != 0;
+        p->recent_cpu = -1.0;
+        if (tgid) {
+                snprintf(p->dir, sizeof(p->dir), "%d/task/%s", (int)tgid, pidstr);
+        } else {
+                snprintf(p->dir, sizeof(p->dir), "%s", pidstr);
+        }
+        return p;
+}
+
+static int
+is_pid(const struct dirent *entry)
+{
+        return entry->d_type == DT_DIR
+                && strspn(entry->d_name, "0123456789") == strlen(entry->d_name)
+                && strlen(entry->d_name) < sizeof(((proc *)0)->pidstr);
+}
+
+// Threads are only listed when asked for, a process can
+// have thousands of them.
+static int
+load_threads(proc *p)
+{
+        char path[48];
+        snprintf(path, sizeof(path), "%s/task", p->dir);
+
+        int fd = openat(proc_dirfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+                return 0;
+        }
+
+        DIR *dir = fdopendir(fd);
+        if (!dir) {
+                close(fd);
+                return 0;
+        }
+
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+                if (!is_pid(entry)) continue;
+
+                proc *t = proc_new(p->pid, entry->d_name);
+                if (!t) break;
+
+                if (!proc_load(t, PF_STATUS | PF_USER | PF_STAT)) {
+                        proc_free(t);
+                        continue;
+                }
+                dyn_array_append(p->threads, t);
+        }
+
+        closedir(dir);
+        return 1;
+}
+
+// Uses the cgroup v2 path ("0::/path") if there is one,
+// otherwise the path of the first v1 hierarchy.
+static int
+parse_cgroup(proc *p,
+             char *buf,
+             size_t n)
+{
+        const char *path = NULL;
+        size_t len = 0;
+        for (char *line = buf; line && line < buf + n && *line; ) {
+                char *nl = strchr(line, '\n');
+                size_t line_len = nl ? (size_t)(nl - line) : strlen(line);
+                char *colon = memchr(line, ':', line_len);
+                char *colon2 = colon ? memchr(colon + 1, ':', line_len - (size_t)(colon + 1 - line)) : NULL;
+
+                if (colon2 && (!path || !strncmp(line, "0::", 3))) {
+                        path = colon2 + 1;
+                        len = line_len - (size_t)(path - line);
+                        if (!strncmp(line, "0::", 3)) break;
+                }
+
+                line = nl ? nl + 1 : NULL;
+        }
+
+        p->cgroup = path ? intern(path, len) : intern("/", 1);
+        return p->cgroup != NULL;
+}
+
+// The groups that come from one file each, in load order
+// (cmdline falls back to cmd).
+typedef struct {
+        proc_field field;
+        const char *file;
+        size_t cap;
+        int (*parse)(proc *p, char *buf, size_t n);
+} pid_file;
+
+static const pid_file pid_files[] = {
+        { PF_STATUS,  "status",  4096, parse_status },
+        { PF_STAT,    "stat",    1024, parse_stat },
+        { PF_CMDLINE, "cmdline", 4096, parse_cmdline },
+        { PF_CGROUP,  "cgroup",  4096, parse_cgroup },
+};
+
+#define N_PID_FILES (sizeof(pid_files)/sizeof(*pid_files))
+
+static int
+load_file(proc *p,
+          const pid_file *f)
+{
+        char buf[4096];
+        ssize_t n = read_pid_file(p->dir, f->file, buf, f->cap);
+        return n >= 0 && f->parse(p, buf, (size_t)n);
+}
+
+int
+proc_load(proc *p,
+          uint32_t fields)
+{
+        uint32_t missing = fields & ~p->loaded;
+
+        // `user` needs `uid`.
+        if (missing & PF_USER) missing |= PF_STATUS & ~p->loaded;
+
+        for (size_t i = 0; i < N_PID_FILES; ++i) {
+                if (!(missing & pid_files[i].field)) continue;
+                if (!load_file(p, &pid_files[i])) return 0;
+                p->loaded |= pid_files[i].field;
+        }
+        if (missing & PF_USER) {
+                p->user = uid_to_user(p->uid);
+                p->loaded |= PF_USER;
+        }
+        if (missing & PF_THREADS) {
+                if (!load_threads(p)) return 0;
+                p->loaded |= PF_THREADS;
+        }
+
+        return 1;
+}
+
+int
+proc_root_fd(void)
+{
+        if (proc_dirfd == -1) {
+                proc_root_open("/proc");
+        }
+        return proc_dirfd;
+}
+
+static DIR *
+open_root_dir(void)
+{
+        if (proc_root_fd() == -1) {
+                return NULL;
+        }
+
+        // A fresh descriptor so each scan gets its own offset.
+        int fd = openat(proc_dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+                return NULL;
+        }
+
+        DIR *dir = fdopendir(fd);
+        if (!dir) {
+                close(fd);
+        }
+        return dir;
+}
+
+int
+proc_pids(pid_array *out)
+{
+        DIR *dir = open_root_dir();
+        if (!dir) {
+                return -1;
+        }
+
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+                if (is_pid(entry)) {
+                        dyn_array_append(*out, (pid_t)atoi(entry->d_name));
+                }
+        }
+
+        closedir(dir);
+        return 0;
+}
+
+void
+proc_set_reader(fileio_backend backend)
+{
+        scan_reader = backend;
+}
+
+typedef struct {
+        proc *procs[SCAN_BATCH];
+        size_t len;
+        file_read reads[SCAN_BATCH * N_PID_FILES];
+        char paths[SCAN_BATCH * N_PID_FILES][48];
+        char *bufs;
+} scan_batch;
+
+// Reads the files of every proc in the batch with one
+// fileio_read(), then parses them.
+static void
+scan_flush(scan_batch *b,
+           uint32_t fields,
+           proc_ptr_array *out)
+{
+        uint64_t t0 = STATS_BEGIN();
+        size_t kept = out->len;
+        uint32_t files = fields;
+        if (files & PF_USER) files |= PF_STATUS;
+
+        size_t n = 0;
+        for (size_t i = 0; i < b->len; ++i) {
+                char *buf = b->bufs + i * N_PID_FILES * 4096;
+                for (size_t f = 0; f < N_PID_FILES; ++f) {
+                        if (!(files & pid_files[f].field)) continue;
+                        snprintf(b->paths[n], sizeof(b->paths[n]), "%s/%s", b->procs[i]->dir, pid_files[f].file);
+                        b->reads[n] = (file_read) {
+                                .path = b->paths[n],
+                                .buf = buf + f * 4096,
+                                .cap = pid_files[f].cap,
+                        };
+                        ++n;
+                }
+        }
+        size_t calls = fileio_read(scan_reader, proc_dirfd, b->reads, n);
+        STATS_SYSCALLS(calls);
+
+        n = 0;
+        for (size_t i = 0; i < b->len; ++i) {
+                proc *p = b->procs[i];
+                int ok = 1;
+                for (size_t f = 0; f < N_PID_FILES; ++f) {
+                        if (!(files & pid_files[f].field)) continue;
+                        file_read *r = &b->reads[n++];
+                        if (!ok) continue;
+                        ok = r->len >= 0 && pid_files[f].parse(p, r->buf, (size_t)r->len);
+                        if (ok) p->loaded |= pid_files[f].field;
+                }
+
+                // The process may have exited since readdir().
+                if (!ok || !proc_load(p, fields)) {
+                        proc_free(p);
+                        continue;
+                }
+                dyn_array_append(*out, p);
+        }
+        b->len = 0;
+
+        // The processes are read together, so each one gets an
+        // equal share of the batch.
+        kept = out->len - kept;
+        if (stats_enabled && kept) {
+                uint64_t each = (stats_now() - t0) / kept;
+                for (size_t i = 0; i < kept; ++i) stats_record(ST_SCAN_PROC, each);
+        }
+}
+
+int
+proc_scan(proc_ptr_array *out,
+          uint32_t fields)
+{
+        DIR *dir = open_root_dir();
+        if (!dir) {
+                return -1;
+        }
+
+        scan_batch *b = NULL;
+        if (scan_reader != FIO_SYNC) {
+                b = calloc(1, sizeof(*b));
+                if (b && !(b->bufs = malloc(SCAN_BATCH * N_PID_FILES * 4096))) {
+                        free(b);
+                        b = NULL;
+                }
+        }
+
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+                if (!is_pid(entry)) continue;
+
+                proc *p = proc_new(0, entry->d_name);
+                if (!p) break;
+
+                if (b) {
+                        b->procs[b->len++] = p;
+                        if (b->len == SCAN_BATCH) scan_flush(b, fields, out);
+                        continue;
+                }
+
+                uint64_t t0 = STATS_BEGIN();
+
+                // The process may have exited since readdir().
+                if (!proc_load(p, fields)) {
+                        proc_free(p);
+                        continue;
+                }
+
+                dyn_array_append(*out, p);
+                STATS_END(ST_SCAN_PROC, t0);
+        }
+
+        if (b) {
+                scan_flush(b, fields, out);
+                free(b->bufs);
+                free(b);
+        }
+
+        closedir(dir);
+        return 0;
+}
+
+double
+proc_hz(void)
+{
+        static double hz = 0;
+        if (hz == 0) hz = (double)sysconf(_SC_CLK_TCK);
+        return hz;
+}
+
+double
+proc_uptime(void)
+{
+        char buf[64];
+        if (read_pid_file(".", "uptime", buf, sizeof(buf)) <= 0) return 0.0;
+        return strtod(buf, NULL);
+}
+
+// Average CPU usage over the lifetime of `p`, like ps(1).
+double
+proc_cpu_percent(const proc *p,
+                 double uptime)
+{
+        if (!(p->loaded & PF_STAT)) return 0.0;
+
+        double elapsed = uptime - (double)p->start / proc_hz();
+        if (elapsed <= 0) return 0.0;
+
+        return 100.0 * ((double)(p->utime + p->stime) / proc_hz()) / elapsed;
+}
+
+proc *
+proc_get(pid_t pid,
+         uint32_t fields)
+{
+        char pidstr[12];
+        snprintf(pidstr, sizeof(pidstr), "%d", (int)pid);
+        if (proc_root_fd() == -1) return NULL;
+
+        proc *p = proc_new(0, pidstr);
+        if (p && !proc_load(p, fields)) {
+                proc_free(p);
+                return NULL;
+        }
+        return p;
+}
+
+void
+proc_free(proc *p)
+{
+        if (!p) return;
+        for (size_t i = 0; i < p->threads.len; ++i) {
+                proc_free(p->threads.data[i]);
+        }
+        dyn_array_free(p->threads);
+        free(p->args);
+        free(p);
+}
+
+void
+proc_cleanup(void)
+{
+        uid_entry *e = atomic_exchange(&uid_cache, NULL);
+        while (e) {
+                uid_entry *next = e->next;
+                free(e->name);
+                free(e);
+                e = next;
+        }
+        fileio_cleanup();
+        if (proc_dirfd != -1) {
+                close(proc_dirfd);
+                proc_dirfd = -1;
+        }
+}
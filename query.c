@@ -0,0 +1,712 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+#include <time.h>
+
+#include "query.h"
+#include "dfa.h"
+#include "net.h"
+
+typedef enum {
+        QF_ANY = 0,
+        QF_PID,
+        QF_PPID,
+        QF_UID,
+        QF_RSS,
+        QF_USER,
+        QF_CMD,
+        QF_ARGS,
+        QF_THREAD,
+        QF_CGROUP,
+        QF_PORT,
+} query_field;
+
+typedef enum {
+        QO_EQ = 0,
+        QO_LT,
+        QO_LE,
+        QO_GT,
+        QO_GE,
+        QO_SUBSTR,
+        QO_STREQ,
+        QO_REGEX,
+} query_op;
+
+// match_str() results by string pointer, see query_memoize().
+// Direct mapped: a collision only costs a recomputation.
+#define MEMO_BITS 10
+#define MEMO_SLOTS (1 << MEMO_BITS)
+
+typedef struct {
+        const char *key[MEMO_SLOTS];
+        uint8_t hit[MEMO_SLOTS];
+} memo;
+
+typedef struct {
+        query_field field;
+        query_op op;
+        int negate;
+        int cost;
+        uint32_t load; // proc_field mask the predicate reads
+        size_t order; // position in the source, keeps the sort stable
+        uint64_t num;
+        char *str;    // lowercased for QO_SUBSTR and QO_STREQ
+        dfa *dfa;     // NULL if the regex needs `re`
+        regex_t re;
+        pid_array owners; // sorted, for QF_PORT
+        memo *memo;   // NULL unless memoized
+} predicate;
+
+DYN_ARRAY_TYPE(predicate, predicate_array);
+
+struct query {
+        predicate_array preds;
+        uint32_t fields;
+        const char *literal; // borrowed from one of the predicates
+};
+
+static const struct {
+        const char *name;
+        query_field field;
+        uint32_t load;
+        int cost; // relative cost of having the field available
+} fields[] = {
+        {"pid",  QF_PID,  0,          0},
+        {"ppid", QF_PPID, PF_STATUS,  0},
+        {"uid",  QF_UID,  PF_STATUS,  0},
+        {"rss",  QF_RSS,  PF_STATUS,  0},
+        {"port", QF_PORT, 0,          0},
+        {"cmd",  QF_CMD,  PF_STATUS,  0},
+        {"user", QF_USER, PF_USER,    1},
+        {"args", QF_ARGS, PF_CMDLINE, 40},
+        {"cgroup", QF_CGROUP, PF_CGROUP, 30},
+        {"thread", QF_THREAD, PF_THREADS, 80},
+};
+
+#define FIELDS_LEN (sizeof(fields)/sizeof(*fields))
+
+static int
+is_numeric(query_field f)
+{
+        return f == QF_PID || f == QF_PPID || f == QF_UID || f == QF_RSS || f == QF_PORT;
+}
+
+// Cheap and selective predicates go first so the expensive
+// ones (regex, lazily loaded files) see as few procs as possible.
+static int
+op_cost(query_op op,
+        int negate)
+{
+        int c;
+        switch (op) {
+        case QO_EQ:     c = 0;  break;
+        case QO_LT:
+        case QO_LE:
+        case QO_GT:
+        case QO_GE:     c = 2;  break;
+        case QO_STREQ:  c = 3;  break;
+        case QO_SUBSTR: c = 6;  break;
+        case QO_REGEX:  c = 20; break;
+        default:        c = 20; break;
+        }
+        // A negated term usually lets most procs through.
+        return c + (negate ? 4 : 0);
+}
+
+static int
+parse_num(const char *s,
+          size_t len,
+          uint64_t *out)
+{
+        if (len == 0) return 0;
+
+        uint64_t n = 0;
+        size_t i = 0;
+        for (; i < len && isdigit((unsigned char)s[i]); ++i) {
+                uint64_t d = (uint64_t)(s[i] - '0');
+                if (n > (UINT64_MAX - d) / 10) return 0;
+                n = n * 10 + d;
+        }
+        if (i == 0) return 0;
+
+        if (i < len) {
+                if (i + 1 != len) return 0;
+                int shift;
+                switch (tolower((unsigned char)s[i])) {
+                case 'k': shift = 10; break;
+                case 'm': shift = 20; break;
+                case 'g': shift = 30; break;
+                default: return 0;
+                }
+                if (n > UINT64_MAX >> shift) return 0;
+                n <<= shift;
+        }
+
+        *out = n;
+        return 1;
+}
+
+static char *
+lowerdup(const char *s,
+         size_t len)
+{
+        char *r = malloc(len + 1);
+        if (!r) return NULL;
+        for (size_t i = 0; i < len; ++i) {
+                r[i] = (char)tolower((unsigned char)s[i]);
+        }
+        r[len] = '\0';
+        return r;
+}
+
+// A basic regex written as an extended one, so the DFA can take
+// it: what only extended regexes treat specially is escaped, and
+// so are `*`, `^` and `$` where a basic regex takes them
+// literally. NULL for backslashes (\( \{ \+ and back references)
+// and for classes like [:alpha:], regcomp() gets those as is.
+static char *
+bre_to_ere(const char *s,
+           size_t len)
+{
+        char *out = malloc(len * 2 + 1);
+        if (!out) return NULL;
+
+        size_t n = 0;
+        for (size_t i = 0; i < len; ++i) {
+                char c = s[i];
+                if (c == '\\') goto fail;
+                if (c == '[') {
+                        // The same in both, copied as is
+                        size_t j = i + 1;
+                        if (j < len && s[j] == '^') ++j;
+                        if (j < len && s[j] == ']') ++j;
+                        while (j < len && s[j] != ']') {
+                                if (s[j] == '[') goto fail;
+                                ++j;
+                        }
+                        if (j == len) goto fail;
+                        memcpy(out + n, s + i, j - i + 1);
+                        n += j - i + 1;
+                        i = j;
+                        continue;
+                }
+
+                int literal = strchr("+?(){}|]", c) != NULL;
+                if (c == '*') literal = i == 0 || (i == 1 && s[0] == '^');
+                if (c == '^') literal = i != 0;
+                if (c == '$') literal = i != len - 1;
+                if (c == '*' && !literal && s[i-1] == '*') goto fail; // glibc refuses a**
+                if (literal) out[n++] = '\\';
+                out[n++] = c;
+        }
+        out[n] = '\0';
+        return out;
+
+fail:
+        free(out);
+        return NULL;
+}
+
+static int
+compile_regex(predicate *pred,
+              const char *s,
+              size_t len,
+              int extended)
+{
+        // The DFA is reused for every proc and field the query
+        // is matched against, and only handles what searches
+        // commonly use. The rest goes to libc.
+        if (extended) {
+                pred->dfa = dfa_compile(s, len, 1);
+        } else {
+                char *ere = bre_to_ere(s, len);
+                if (ere) pred->dfa = dfa_compile(ere, strlen(ere), 1);
+                free(ere);
+        }
+        if (pred->dfa) {
+                pred->op = QO_REGEX;
+                return 1;
+        }
+
+        char *pattern = malloc(len + 1);
+        if (!pattern) return 0;
+        memcpy(pattern, s, len);
+        pattern[len] = '\0';
+        int reti = regcomp(&pred->re, pattern, REG_ICASE | REG_NOSUB | (extended ? REG_EXTENDED : 0));
+        free(pattern);
+        if (reti) return 0;
+        pred->op = QO_REGEX;
+        return 1;
+}
+
+static void
+predicate_free(predicate *pred)
+{
+        free(pred->str);
+        free(pred->memo);
+        dyn_array_free(pred->owners);
+        if (pred->dfa) {
+                dfa_free(pred->dfa);
+        } else if (pred->op == QO_REGEX) {
+                regfree(&pred->re);
+        }
+}
+
+// The TUI compiles the query again on every keystroke, and each
+// compile would walk every fd again for the same port terms. The
+// owners of a port range are kept for a little while instead.
+#define PORT_CACHE_MS  1000
+#define PORT_CACHE_LEN 4
+
+static struct {
+        pthread_mutex_t lock;
+        struct {
+                unsigned lo, hi;
+                uint64_t ms; // when looked up, 0 if unused
+                pid_array owners;
+        } slot[PORT_CACHE_LEN];
+} ports = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint64_t
+now_ms(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void
+port_owners(unsigned lo,
+            unsigned hi,
+            int fresh,
+            pid_array *out)
+{
+        uint64_t now = now_ms();
+
+        pthread_mutex_lock(&ports.lock);
+        size_t hit = PORT_CACHE_LEN, oldest = 0;
+        for (size_t i = 0; i < PORT_CACHE_LEN; ++i) {
+                if (ports.slot[i].ms && ports.slot[i].lo == lo && ports.slot[i].hi == hi) hit = i;
+                if (ports.slot[i].ms < ports.slot[oldest].ms) oldest = i;
+        }
+        if (hit == PORT_CACHE_LEN || fresh || now - ports.slot[hit].ms >= PORT_CACHE_MS) {
+                if (hit == PORT_CACHE_LEN) hit = oldest;
+                net_port_owners(lo, hi, &ports.slot[hit].owners);
+                ports.slot[hit].lo = lo;
+                ports.slot[hit].hi = hi;
+                ports.slot[hit].ms = now;
+        }
+
+        out->len = 0;
+        for (size_t i = 0; i < ports.slot[hit].owners.len; ++i) {
+                dyn_array_append(*out, ports.slot[hit].owners.data[i]);
+        }
+        pthread_mutex_unlock(&ports.lock);
+}
+
+// Sockets only tell us their inode, finding the owners means
+// walking every fd of every process. Do it once per query
+// instead of per process, and reuse it for a while unless
+// `fresh` asks for a new look.
+static void
+resolve_port(predicate *pred,
+             int fresh)
+{
+        unsigned n = (unsigned)pred->num; // <= 65535, see parse_term
+        unsigned lo = 0, hi = 65535;
+        switch (pred->op) {
+        case QO_EQ: lo = hi = n;                  break;
+        case QO_LT: if (n == 0) return; hi = n-1; break;
+        case QO_LE: hi = n;                       break;
+        case QO_GT: if (n == 65535) return; lo = n+1; break;
+        case QO_GE: lo = n;                       break;
+        default: break;
+        }
+        port_owners(lo, hi, fresh, &pred->owners);
+}
+
+static int
+pid_cmp(const void *a,
+        const void *b)
+{
+        pid_t x = *(const pid_t *)a, y = *(const pid_t *)b;
+        return x < y ? -1 : x > y;
+}
+
+// Parses one term. Returns 1 on success, 0 if the term is
+// malformed, and -1 if it is an incomplete term that should
+// be skipped (e.g. `rss:>` while the user is still typing).
+static int
+parse_term(const char *s,
+           size_t len,
+           predicate *pred,
+           uint32_t *load)
+{
+        memset(pred, 0, sizeof(*pred));
+
+        if (len > 1 && s[0] == '!') {
+                pred->negate = 1;
+                ++s, --len;
+        }
+
+        const char *colon = memchr(s, ':', len);
+        size_t fi = FIELDS_LEN;
+        if (colon) {
+                size_t flen = (size_t)(colon - s);
+                for (fi = 0; fi < FIELDS_LEN; ++fi) {
+                        if (strlen(fields[fi].name) == flen
+                            && !strncmp(fields[fi].name, s, flen)) {
+                                break;
+                        }
+                }
+        }
+
+        // No (known) field: a basic regex over cmd, user and pid,
+        // as the search box has always been, or an extended one
+        // with `~`. In a basic regex `+`, `?`, `(` and `|` are
+        // plain characters, and a word without `.`, `[`, `*`, `^`,
+        // `$` or `\` is just a substring, which the index can use.
+        if (fi == FIELDS_LEN) {
+                pred->field = QF_ANY;
+                pred->load = PF_STATUS | PF_USER;
+                *load |= pred->load;
+                if (s[0] == '~') {
+                        if (len == 1) return -1;
+                        pred->cost = op_cost(QO_REGEX, pred->negate) * 3 + 1;
+                        return compile_regex(pred, s + 1, len - 1, 1);
+                }
+                for (size_t i = 0; i < len; ++i) {
+                        if (!strchr(".[*^$\\", s[i])) continue;
+                        pred->cost = op_cost(QO_REGEX, pred->negate) * 3 + 1;
+                        return compile_regex(pred, s, len, 0);
+                }
+                pred->op = QO_SUBSTR;
+                pred->cost = op_cost(QO_SUBSTR, pred->negate) * 3 + 1;
+                return (pred->str = lowerdup(s, len)) != NULL;
+        }
+
+        pred->field = fields[fi].field;
+        pred->load = fields[fi].load;
+        *load |= pred->load;
+
+        const char *v = colon + 1;
+        size_t vlen = len - (size_t)(v - s);
+
+        if (is_numeric(pred->field)) {
+                pred->op = QO_EQ;
+                if (vlen >= 2 && v[0] == '>' && v[1] == '=') pred->op = QO_GE, v += 2, vlen -= 2;
+                else if (vlen >= 2 && v[0] == '<' && v[1] == '=') pred->op = QO_LE, v += 2, vlen -= 2;
+                else if (vlen >= 1 && v[0] == '>') pred->op = QO_GT, ++v, --vlen;
+                else if (vlen >= 1 && v[0] == '<') pred->op = QO_LT, ++v, --vlen;
+                else if (vlen >= 1 && v[0] == '=') ++v, --vlen;
+
+                if (vlen == 0) return -1;
+                if (!parse_num(v, vlen, &pred->num)) return 0;
+                if (pred->field == QF_PORT) {
+                        if (pred->num > 65535) return 0;
+                        resolve_port(pred, 0);
+                }
+        } else if (vlen >= 1 && v[0] == '~') {
+                if (!compile_regex(pred, v + 1, vlen - 1, 1)) return 0;
+        } else if (vlen >= 1 && v[0] == '=') {
+                pred->op = QO_STREQ;
+                if (!(pred->str = lowerdup(v + 1, vlen - 1))) return 0;
+        } else {
+                if (vlen == 0) return -1;
+                pred->op = QO_SUBSTR;
+                if (!(pred->str = lowerdup(v, vlen))) return 0;
+        }
+
+        pred->cost = fields[fi].cost + op_cost(pred->op, pred->negate);
+        return 1;
+}
+
+static int
+predicate_cmp(const void *a,
+              const void *b)
+{
+        const predicate *pa = a, *pb = b;
+        if (pa->cost != pb->cost) return pa->cost < pb->cost ? -1 : 1;
+        return pa->order < pb->order ? -1 : pa->order > pb->order;
+}
+
+static query *
+compile(const char *src,
+        size_t len,
+        int strict)
+{
+        query *q = calloc(1, sizeof(*q));
+        if (!q) return NULL;
+
+        size_t i = 0, order = 0;
+        while (i < len) {
+                while (i < len && isspace((unsigned char)src[i])) ++i;
+                size_t start = i;
+                while (i < len && !isspace((unsigned char)src[i])) ++i;
+                if (i == start) break;
+
+                predicate pred;
+                int ok = parse_term(src + start, i - start, &pred, &q->fields);
+                if (ok == 0 || (ok == -1 && strict)) {
+                        predicate_free(&pred);
+                        query_free(q);
+                        return NULL;
+                } else if (ok == 1) {
+                        pred.order = order++;
+                        dyn_array_append(q->preds, pred);
+                }
+        }
+
+        if (q->preds.len > 1) {
+                qsort(q->preds.data, q->preds.len, sizeof(predicate), predicate_cmp);
+        }
+
+        // The longest substring every match must contain, for
+        // narrowing the search with the trigram index.
+        for (size_t j = 0; j < q->preds.len; ++j) {
+                const predicate *pred = &q->preds.data[j];
+                if (pred->negate || !pred->str) continue;
+                if (pred->field != QF_ANY && pred->field != QF_CMD && pred->field != QF_USER) continue;
+                if (!q->literal || strlen(pred->str) > strlen(q->literal)) {
+                        q->literal = pred->str;
+                }
+        }
+
+        return q;
+}
+
+query *
+query_compile(const char *src,
+              size_t len)
+{
+        return compile(src, len, 0);
+}
+
+query *
+query_compile_strict(const char *src,
+                     size_t len)
+{
+        return compile(src, len, 1);
+}
+
+static int
+contains_icase(const char *hay,
+               const char *needle)
+{
+        if (!*needle) return 1;
+        for (; *hay; ++hay) {
+                size_t i = 0;
+                while (needle[i] && tolower((unsigned char)hay[i]) == needle[i]) ++i;
+                if (!needle[i]) return 1;
+        }
+        return 0;
+}
+
+static int
+equals_icase(const char *s,
+             const char *lower)
+{
+        for (; *s && *lower; ++s, ++lower) {
+                if (tolower((unsigned char)*s) != *lower) return 0;
+        }
+        return *s == *lower;
+}
+
+static int
+match_num(const predicate *pred,
+          uint64_t v)
+{
+        switch (pred->op) {
+        case QO_EQ: return v == pred->num;
+        case QO_LT: return v <  pred->num;
+        case QO_LE: return v <= pred->num;
+        case QO_GT: return v >  pred->num;
+        case QO_GE: return v >= pred->num;
+        default:    return 0;
+        }
+}
+
+static int
+match_str(const predicate *pred,
+          const char *s)
+{
+        if (!s) return 0;
+        switch (pred->op) {
+        case QO_SUBSTR: return contains_icase(s, pred->str);
+        case QO_STREQ:  return equals_icase(s, pred->str);
+        case QO_REGEX:
+                if (pred->dfa) return dfa_match(pred->dfa, s);
+                return regexec(&pred->re, s, 0, NULL, 0) == 0;
+        default:        return 0;
+        }
+}
+
+// For strings shared between procs (interned cmd and cgroup,
+// user from the uid cache), so each distinct one is matched once.
+static int
+match_shared(const predicate *pred,
+             const char *s)
+{
+        if (!pred->memo || !s) return match_str(pred, s);
+
+        size_t i = (size_t)(((uint64_t)(uintptr_t)s * 0x9e3779b97f4a7c15ull) >> (64 - MEMO_BITS));
+        if (pred->memo->key[i] != s) {
+                pred->memo->key[i] = s;
+                pred->memo->hit[i] = (uint8_t)match_str(pred, s);
+        }
+        return pred->memo->hit[i];
+}
+
+static int
+match_predicate(const predicate *pred,
+                proc *p)
+{
+        if (!proc_load(p, pred->load)) return 0;
+
+        switch (pred->field) {
+        case QF_ANY:
+                return match_shared(pred, p->cmd)
+                        || match_shared(pred, p->user)
+                        || match_str(pred, p->pidstr);
+        case QF_PID:  return match_num(pred, (uint64_t)p->pid);
+        case QF_PPID: return match_num(pred, (uint64_t)p->ppid);
+        case QF_UID:  return match_num(pred, (uint64_t)p->uid);
+        case QF_RSS:  return match_num(pred, p->rss);
+        case QF_PORT:
+                return bsearch(&p->tgid, pred->owners.data, pred->owners.len,
+                               sizeof(pid_t), pid_cmp) != NULL;
+        case QF_USER: return match_shared(pred, p->user);
+        case QF_CMD:  return match_shared(pred, p->cmd);
+        case QF_ARGS: return match_str(pred, p->args);
+        case QF_CGROUP: return match_shared(pred, p->cgroup);
+        case QF_THREAD:
+                for (size_t i = 0; i < p->threads.len; ++i) {
+                        if (match_shared(pred, p->threads.data[i]->cmd)) return 1;
+                }
+                return 0;
+        }
+        return 0;
+}
+
+int
+query_match(const query *q,
+            proc *p)
+{
+        for (size_t i = 0; i < q->preds.len; ++i) {
+                const predicate *pred = &q->preds.data[i];
+                if (match_predicate(pred, p) == pred->negate) {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+const char *
+query_literal(const query *q)
+{
+        return q->literal;
+}
+
+int
+query_uses_port(const query *q)
+{
+        for (size_t i = 0; i < q->preds.len; ++i) {
+                if (q->preds.data[i].field == QF_PORT) return 1;
+        }
+        return 0;
+}
+
+void
+query_resolve_ports(query *q)
+{
+        for (size_t i = 0; i < q->preds.len; ++i) {
+                if (q->preds.data[i].field == QF_PORT) resolve_port(&q->preds.data[i], 1);
+        }
+}
+
+void
+query_cleanup(void)
+{
+        pthread_mutex_lock(&ports.lock);
+        for (size_t i = 0; i < PORT_CACHE_LEN; ++i) {
+                dyn_array_free(ports.slot[i].owners);
+                ports.slot[i].ms = 0;
+        }
+        pthread_mutex_unlock(&ports.lock);
+}
+
+int
+query_prebuild(query *q)
+{
+        for (size_t i = 0; i < q->preds.len; ++i) {
+                predicate *pred = &q->preds.data[i];
+                if (pred->op != QO_REGEX) continue;
+                if (!pred->dfa || !dfa_build_all(pred->dfa)) return 0;
+        }
+        return 1;
+}
+
+void
+query_memoize(query *q)
+{
+        for (size_t i = 0; i < q->preds.len; ++i) {
+                predicate *pred = &q->preds.data[i];
+                if (is_numeric(pred->field) || pred->field == QF_ARGS || pred->memo) continue;
+                pred->memo = calloc(1, sizeof(memo));
+        }
+}
+
+uint32_t
+query_fields(const query *q)
+{
+        return q->fields;
+}
+
+int
+query_is_static(const query *q)
+{
+        for (size_t i = 0; i < q->preds.len; ++i) {
+                switch (q->preds.data[i].field) {
+                case QF_ANY: case QF_PID: case QF_UID: case QF_USER: case QF_CMD: case QF_ARGS:
+                        break;
+                default:
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+void
+query_free(query *q)
+{
+        if (!q) return;
+        for (size_t i = 0; i < q->preds.len; ++i) {
+                predicate_free(&q->preds.data[i]);
+        }
+        dyn_array_free(q->preds);
+        free(q);
+}
@@ -0,0 +1,206 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <ncurses.h>
+
+#include "replay.h"
+#include "dyn_array.h"
+
+DYN_ARRAY_TYPE(int, int_array);
+DYN_ARRAY_TYPE(uint64_t, u64_array);
+
+struct replay {
+        int_array keys;
+        size_t next;
+        uint64_t arrived; // ns, 0 when no key is pending
+        u64_array latency; // ns, one per key
+};
+
+static const struct {
+        const char *name;
+        int key;
+} named[] = {
+        {"up",    KEY_UP},
+        {"down",  KEY_DOWN},
+        {"bs",    KEY_BACKSPACE},
+        {"tab",   '\t'},
+        {"enter", '\n'},
+};
+
+static uint64_t
+now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int
+parse_named(const char *s,
+            size_t len)
+{
+        if (len == 3 && tolower((unsigned char)s[0]) == 'c' && s[1] == '-') {
+                return s[2] & 0x1F;
+        }
+        for (size_t i = 0; i < sizeof(named)/sizeof(*named); ++i) {
+                if (strlen(named[i].name) == len && !strncasecmp(named[i].name, s, len)) {
+                        return named[i].key;
+                }
+        }
+        return -1;
+}
+
+replay *
+replay_load(const char *path)
+{
+        FILE *f = fopen(path, "r");
+        if (!f) return NULL;
+
+        replay *r = calloc(1, sizeof(*r));
+        char buf[4096];
+        size_t n;
+        dyn_array(char, text);
+
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+                for (size_t i = 0; i < n; ++i) dyn_array_append(text, buf[i]);
+        }
+        fclose(f);
+
+        for (size_t i = 0; i < text.len; ++i) {
+                char c = text.data[i];
+                if (c == '\n' || c == '\r') continue;
+
+                if (c == '<') {
+                        char *end = memchr(text.data + i, '>', text.len - i);
+                        int key = end ? parse_named(text.data + i + 1, (size_t)(end - text.data) - i - 1) : -1;
+                        if (key != -1) {
+                                dyn_array_append(r->keys, key);
+                                i = (size_t)(end - text.data);
+                                continue;
+                        }
+                }
+
+                dyn_array_append(r->keys, (int)(unsigned char)c);
+        }
+
+        dyn_array_free(text);
+        return r;
+}
+
+int
+replay_next_key(replay *r)
+{
+        if (r->next >= r->keys.len) {
+                return 'q' & 0x1F;
+        }
+        r->arrived = now_ns();
+        return r->keys.data[r->next++];
+}
+
+void
+replay_key_done(replay *r)
+{
+        if (!r->arrived) return;
+        dyn_array_append(r->latency, now_ns() - r->arrived);
+        r->arrived = 0;
+}
+
+static void
+describe_key(int key,
+             char *buf,
+             size_t n)
+{
+        for (size_t i = 0; i < sizeof(named)/sizeof(*named); ++i) {
+                if (named[i].key == key) {
+                        snprintf(buf, n, "<%s>", named[i].name);
+                        return;
+                }
+        }
+        if (key < 32) snprintf(buf, n, "<c-%c>", key + 'a' - 1);
+        else snprintf(buf, n, "%c", key);
+}
+
+static int
+u64_cmp(const void *a,
+        const void *b)
+{
+        uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+        return x < y ? -1 : x > y;
+}
+
+// Nearest rank percentile of sorted `v`.
+static uint64_t
+percentile(const u64_array *v,
+           double p)
+{
+        size_t rank = (size_t)(p / 100.0 * (double)v->len + 0.999999);
+        if (rank == 0) rank = 1;
+        return v->data[rank - 1];
+}
+
+void
+replay_report(const replay *r,
+              FILE *out)
+{
+        size_t n = r->latency.len;
+        if (n == 0) {
+                fprintf(out, "replay keys=0\n");
+                return;
+        }
+
+        size_t worst = 0;
+        for (size_t i = 1; i < n; ++i) {
+                if (r->latency.data[i] > r->latency.data[worst]) worst = i;
+        }
+
+        u64_array sorted = dyn_array_empty(u64_array);
+        for (size_t i = 0; i < n; ++i) dyn_array_append(sorted, r->latency.data[i]);
+        qsort(sorted.data, n, sizeof(uint64_t), u64_cmp);
+
+        char name[16];
+        describe_key(r->keys.data[worst], name, sizeof(name));
+
+        fprintf(out, "replay keys=%zu p50_us=%.1f p95_us=%.1f p99_us=%.1f worst_us=%.1f worst_key=%zu:%s\n",
+                n,
+                percentile(&sorted, 50) / 1e3,
+                percentile(&sorted, 95) / 1e3,
+                percentile(&sorted, 99) / 1e3,
+                r->latency.data[worst] / 1e3,
+                worst, name);
+
+        dyn_array_free(sorted);
+}
+
+void
+replay_free(replay *r)
+{
+        if (!r) return;
+        dyn_array_free(r->keys);
+        dyn_array_free(r->latency);
+        free(r);
+}
@@ -0,0 +1,333 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fileio.h"
+#include "proc.h"
+#include "smaps.h"
+
+// How long the worker sleeps when nobody asks, before it looks
+// for entries that went past their TTL.
+#define IDLE_MS 250
+
+typedef struct {
+        pid_t pid;     // 0 if the slot is empty
+        int ok;        // 0 if the file could not be read
+        uint64_t fetched_ms;
+        smaps_info info;
+} slot;
+
+// A copy of the worker's map for the UI.
+typedef struct {
+        size_t cap;
+        slot slots[];
+} view;
+
+// The UI and the worker hand each other whole arrays: one side
+// swaps a new one in, the other swaps it out, and whoever gets
+// an unseen one back frees it. Neither side takes a lock.
+static struct {
+        slot *slots;   // worker only, after smaps_start()
+        size_t cap;    // power of two
+        size_t len;
+        _Atomic(pid_array *) wanted; // UI -> worker
+        _Atomic(view *) ready;       // worker -> UI
+        view *shown;                 // UI only
+        _Atomic uint64_t generation;
+
+        int running;
+        _Atomic int stopping;
+        int wake[2];
+        pthread_t thread;
+} sm = { .wake = {-1, -1} };
+
+static uint64_t
+now_ms(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static size_t
+hash(pid_t pid)
+{
+        uint32_t k = (uint32_t)pid;
+        k ^= k >> 16;
+        k *= 0x7feb352d;
+        k ^= k >> 15;
+        k *= 0x846ca68b;
+        k ^= k >> 16;
+        return k;
+}
+
+static slot *
+probe(slot *slots,
+      size_t cap,
+      pid_t pid)
+{
+        size_t mask = cap - 1;
+        size_t i = hash(pid) & mask;
+        while (slots[i].pid && slots[i].pid != pid) i = (i + 1) & mask;
+        return &slots[i];
+}
+
+// Rehashes what is still within its TTL into a map with room
+// to spare.
+static int
+evict(uint64_t now)
+{
+        size_t live = 0;
+        for (size_t i = 0; i < sm.cap; ++i) {
+                if (sm.slots[i].pid && now - sm.slots[i].fetched_ms < SMAPS_TTL_MS) ++live;
+        }
+
+        size_t cap = 1024;
+        while (cap < live * 4) cap *= 2;
+        slot *slots = calloc(cap, sizeof(*slots));
+        if (!slots) return -1;
+
+        for (size_t i = 0; i < sm.cap; ++i) {
+                const slot *s = &sm.slots[i];
+                if (s->pid && now - s->fetched_ms < SMAPS_TTL_MS) *probe(slots, cap, s->pid) = *s;
+        }
+        free(sm.slots);
+        sm.slots = slots;
+        sm.cap = cap;
+        sm.len = live;
+        return 0;
+}
+
+static int
+parse_rollup(const char *buf,
+             smaps_info *out)
+{
+        uint64_t private_clean = 0, private_dirty = 0;
+        int seen = 0;
+        memset(out, 0, sizeof(*out));
+
+        for (const char *line = buf; line && *line; ) {
+                if (!strncmp(line, "Pss:", 4)) {
+                        out->pss = strtoull(line + 4, NULL, 10) * 1024;
+                        seen = 1;
+                } else if (!strncmp(line, "Private_Clean:", 14)) {
+                        private_clean = strtoull(line + 14, NULL, 10) * 1024;
+                } else if (!strncmp(line, "Private_Dirty:", 14)) {
+                        private_dirty = strtoull(line + 14, NULL, 10) * 1024;
+                } else if (!strncmp(line, "Swap:", 5)) {
+                        out->swap = strtoull(line + 5, NULL, 10) * 1024;
+                }
+                line = strchr(line, '\n');
+                if (line) ++line;
+        }
+
+        out->uss = private_clean + private_dirty;
+        return seen;
+}
+
+// Kernel threads have an empty rollup, processes we may not
+// ptrace cannot open it. Both are cached as not ok.
+static int
+read_rollup(pid_t pid,
+            smaps_info *out)
+{
+        char path[32], buf[4096];
+        snprintf(path, sizeof(path), "%d/smaps_rollup", (int)pid);
+
+        file_read r = { .path = path, .buf = buf, .cap = sizeof(buf) };
+        fileio_read(FIO_SYNC, proc_root_fd(), &r, 1);
+        return r.len > 0 && parse_rollup(buf, out);
+}
+
+static int
+fresh(pid_t pid,
+      uint64_t now)
+{
+        const slot *s = probe(sm.slots, sm.cap, pid);
+        return s->pid && now - s->fetched_ms < SMAPS_TTL_MS;
+}
+
+static void
+store(pid_t pid,
+      int ok,
+      const smaps_info *info,
+      uint64_t now)
+{
+        if ((sm.len + 1) * 4 > sm.cap * 3 && evict(now) == -1) return;
+        slot *s = probe(sm.slots, sm.cap, pid);
+        if (!s->pid) sm.len++;
+        *s = (slot) { .pid = pid, .ok = ok, .fetched_ms = now, .info = *info };
+}
+
+// Hands a copy of the map to the UI.
+static void
+publish(void)
+{
+        view *v = malloc(sizeof(*v) + sm.cap * sizeof(slot));
+        if (!v) return;
+        v->cap = sm.cap;
+        memcpy(v->slots, sm.slots, sm.cap * sizeof(slot));
+        free(atomic_exchange(&sm.ready, v));
+        atomic_fetch_add(&sm.generation, 1);
+}
+
+static void
+free_pids(pid_array *pids)
+{
+        if (!pids) return;
+        dyn_array_free(*pids);
+        free(pids);
+}
+
+static void *
+worker_run(void *arg)
+{
+        (void)arg;
+        pid_array *todo = NULL;
+        struct pollfd pfd = { .fd = sm.wake[0], .events = POLLIN };
+
+        while (!atomic_load(&sm.stopping)) {
+                if (poll(&pfd, 1, IDLE_MS) > 0) {
+                        char buf[64];
+                        while (read(sm.wake[0], buf, sizeof(buf)) > 0);
+                }
+                if (atomic_load(&sm.stopping)) break;
+
+                pid_array *newer = atomic_exchange(&sm.wanted, NULL);
+                if (newer) {
+                        free_pids(todo);
+                        todo = newer;
+                }
+                if (!todo) continue;
+
+                // Whatever is left over waits for the next frame
+                uint64_t start = now_ms();
+                int stored = 0;
+                for (size_t i = 0; i < todo->len; ++i) {
+                        uint64_t now = now_ms();
+                        if (now - start >= SMAPS_FRAME_BUDGET_MS || atomic_load(&sm.stopping)) break;
+                        if (fresh(todo->data[i], now)) continue;
+
+                        smaps_info info;
+                        int ok = read_rollup(todo->data[i], &info);
+                        store(todo->data[i], ok, &info, now_ms());
+                        stored = 1;
+                }
+                if (stored) publish();
+        }
+
+        free_pids(todo);
+        return NULL;
+}
+
+int
+smaps_start(void)
+{
+        if (sm.running) return 0;
+        if (!sm.slots && !(sm.slots = calloc(sm.cap = 1024, sizeof(*sm.slots)))) return -1;
+        if (pipe2(sm.wake, O_CLOEXEC | O_NONBLOCK) == -1) return -1;
+
+        atomic_store(&sm.stopping, 0);
+        if (pthread_create(&sm.thread, NULL, worker_run, NULL) != 0) {
+                close(sm.wake[0]);
+                close(sm.wake[1]);
+                return -1;
+        }
+        sm.running = 1;
+        return 0;
+}
+
+void
+smaps_want(const pid_t *pids,
+           size_t n)
+{
+        if (!sm.running) return;
+
+        pid_array *want = malloc(sizeof(*want));
+        if (!want) return;
+        *want = dyn_array_empty(pid_array);
+        for (size_t i = 0; i < n; ++i) {
+                dyn_array_append(*want, pids[i]);
+        }
+        free_pids(atomic_exchange(&sm.wanted, want));
+
+        // A full pipe already means "wake up"
+        char byte = 0;
+        while (write(sm.wake[1], &byte, 1) == -1 && errno == EINTR);
+}
+
+int
+smaps_get(pid_t pid,
+          smaps_info *out)
+{
+        if (!sm.running) return 0;
+
+        if (atomic_load_explicit(&sm.ready, memory_order_relaxed)) {
+                view *v = atomic_exchange(&sm.ready, NULL);
+                if (v) {
+                        free(sm.shown);
+                        sm.shown = v;
+                }
+        }
+        if (!sm.shown) return 0;
+
+        const slot *s = probe(sm.shown->slots, sm.shown->cap, pid);
+        if (!s->pid || !s->ok) return 0;
+        *out = s->info;
+        return 1;
+}
+
+uint64_t
+smaps_generation(void)
+{
+        return atomic_load(&sm.generation);
+}
+
+void
+smaps_stop(void)
+{
+        if (sm.running) {
+                atomic_store(&sm.stopping, 1);
+                char byte = 0;
+                while (write(sm.wake[1], &byte, 1) == -1 && errno == EINTR);
+                pthread_join(sm.thread, NULL);
+                close(sm.wake[0]);
+                close(sm.wake[1]);
+                sm.running = 0;
+        }
+        free(sm.slots);
+        free(atomic_exchange(&sm.ready, NULL));
+        free(sm.shown);
+        free_pids(atomic_exchange(&sm.wanted, NULL));
+        sm.slots = NULL;
+        sm.shown = NULL;
+        sm.cap = sm.len = 0;
+}
@@ -0,0 +1,335 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+// Everything a snapshot has, so proc_load() never goes to /proc
+// for a proc that came out of one.
+#define SNAPSHOT_FIELDS (PF_STATUS | PF_USER | PF_STAT | PF_CMDLINE | PF_THREADS | PF_CGROUP)
+
+struct snapshot {
+        void *base;
+        size_t len;
+        proc *procs;          // one allocation for all of them
+        proc_ptr_array table; // points into `procs`
+};
+
+DYN_ARRAY_TYPE(char, string_pool);
+
+typedef struct {
+        const char *s;
+        uint32_t off;
+} pool_entry;
+
+// Pointer -> offset, open addressing.
+typedef struct {
+        pool_entry *data;
+        size_t len, cap; // cap is a power of two
+} pool_map;
+
+static size_t
+ptr_hash(const char *s)
+{
+        uintptr_t x = (uintptr_t)s;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        return (size_t)x;
+}
+
+// NULL if the map is full and cannot grow.
+static pool_entry *
+pool_map_slot(pool_map *m,
+              const char *s)
+{
+        if ((m->len + 1) * 2 > m->cap) {
+                pool_map old = *m;
+                m->cap = old.cap ? old.cap * 2 : 64;
+                m->data = calloc(m->cap, sizeof(pool_entry));
+                if (!m->data) {
+                        *m = old;
+                        return NULL;
+                }
+                m->len = 0;
+                for (size_t i = 0; i < old.cap; ++i) {
+                        if (!old.data[i].s) continue;
+                        *pool_map_slot(m, old.data[i].s) = old.data[i];
+                        m->len++;
+                }
+                free(old.data);
+        }
+
+        size_t i = ptr_hash(s) & (m->cap - 1);
+        while (m->data[i].s && m->data[i].s != s) i = (i + 1) & (m->cap - 1);
+        return &m->data[i];
+}
+
+// user, cmd and cgroup strings are shared between procs (uid
+// cache, interning), so a pointer lookup dedups most of the pool.
+// Without memory for the lookup the string is just stored again.
+static uint32_t
+pool_add(string_pool *pool,
+         pool_map *seen,
+         const char *s,
+         int shared)
+{
+        if (!s) return SNAPSHOT_NO_STRING;
+
+        pool_entry *e = shared ? pool_map_slot(seen, s) : NULL;
+        if (e && e->s) return e->off;
+
+        uint32_t off = (uint32_t)pool->len;
+        for (size_t i = 0; s[i]; ++i) dyn_array_append(*pool, s[i]);
+        dyn_array_append(*pool, '\0');
+
+        if (e) {
+                *e = (pool_entry) { .s = s, .off = off };
+                seen->len++;
+        }
+        return off;
+}
+
+static int
+write_all(int fd,
+          const void *buf,
+          size_t len)
+{
+        const char *p = buf;
+        while (len > 0) {
+                ssize_t n = write(fd, p, len);
+                if (n < 0) {
+                        if (errno == EINTR) continue;
+                        return -1;
+                }
+                p += n;
+                len -= (size_t)n;
+        }
+        return 0;
+}
+
+int
+snapshot_write(int fd,
+               const proc_ptr_array *procs,
+               uint64_t generation)
+{
+        string_pool pool = dyn_array_empty(string_pool);
+        pool_map seen = {0};
+        snapshot_record *records = calloc(procs->len ? procs->len : 1, sizeof(*records));
+        size_t count = 0;
+        int res = -1;
+
+        if (!records) return -1;
+
+        for (size_t i = 0; i < procs->len; ++i) {
+                proc *p = procs->data[i];
+                // Exited since the scan.
+                if (!proc_load(p, PF_STATUS | PF_USER | PF_STAT | PF_CMDLINE | PF_CGROUP)) {
+                        continue;
+                }
+
+                snapshot_record *r = &records[count++];
+                r->pid = p->pid;
+                r->tgid = p->tgid;
+                r->ppid = p->ppid;
+                r->uid = p->uid;
+                r->rss = p->rss;
+                r->utime = p->utime;
+                r->stime = p->stime;
+                r->start = p->start;
+                r->user = pool_add(&pool, &seen, p->user, 1);
+                r->cmd = pool_add(&pool, &seen, p->cmd, 1);
+                r->args = pool_add(&pool, &seen, p->args, 0);
+                r->cgroup = pool_add(&pool, &seen, p->cgroup, 1);
+                memcpy(r->pidstr, p->pidstr, sizeof(r->pidstr));
+                r->thread = (uint32_t)p->thread;
+        }
+
+        snapshot_header h = {0};
+        memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+        h.version = SNAPSHOT_VERSION;
+        h.record_size = sizeof(snapshot_record);
+        h.count = count;
+        h.records_off = sizeof(h);
+        h.strings_off = h.records_off + count * sizeof(snapshot_record);
+        h.strings_len = pool.len;
+        h.generation = generation;
+
+        if (write_all(fd, &h, sizeof(h)) == 0
+            && write_all(fd, records, count * sizeof(snapshot_record)) == 0
+            && write_all(fd, pool.data, pool.len) == 0) {
+                res = 0;
+        }
+
+        free(records);
+        dyn_array_free(pool);
+        free(seen.data);
+        return res;
+}
+
+static const char *
+pool_str(const char *pool,
+         uint32_t off)
+{
+        return off == SNAPSHOT_NO_STRING ? NULL : pool + off;
+}
+
+snapshot *
+snapshot_open_fd(int fd,
+                 int live)
+{
+        struct stat st;
+        if (fstat(fd, &st) == -1) return NULL;
+
+        size_t len = (size_t)st.st_size;
+        if (len < sizeof(snapshot_header)) {
+                errno = EINVAL;
+                return NULL;
+        }
+
+        void *base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) return NULL;
+
+        // Check the layout once. The procs are copied out of the
+        // records, but their strings point into the mapping, and
+        // only their offsets are checked.
+        const snapshot_header *h = base;
+        if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic))
+            || h->version != SNAPSHOT_VERSION
+            || h->record_size != sizeof(snapshot_record)
+            || h->records_off < sizeof(*h)
+            || h->records_off > len
+            || h->records_off % _Alignof(snapshot_record)
+            || h->count > (len - h->records_off) / sizeof(snapshot_record)
+            // No overflow: count * size fits in len - records_off
+            || h->strings_off < h->records_off + h->count * sizeof(snapshot_record)
+            || h->strings_off > len
+            || h->strings_len > len - h->strings_off
+            || (h->strings_len && ((const char *)base)[h->strings_off + h->strings_len - 1] != '\0')) {
+                munmap(base, len);
+                errno = EINVAL;
+                return NULL;
+        }
+        const snapshot_record *records = (const snapshot_record *)((const char *)base + h->records_off);
+        const char *pool = (const char *)base + h->strings_off;
+
+        snapshot *s = calloc(1, sizeof(*s));
+        proc *procs = calloc(h->count ? h->count : 1, sizeof(proc));
+        if (!s || !procs) {
+                free(s);
+                free(procs);
+                munmap(base, len);
+                errno = ENOMEM;
+                return NULL;
+        }
+        s->base = base;
+        s->len = len;
+        s->procs = procs;
+
+        for (size_t i = 0; i < h->count; ++i) {
+                const snapshot_record *r = &records[i];
+                proc *p = &s->procs[i];
+
+                if ((r->user != SNAPSHOT_NO_STRING && r->user >= h->strings_len)
+                    || (r->cmd != SNAPSHOT_NO_STRING && r->cmd >= h->strings_len)
+                    || (r->args != SNAPSHOT_NO_STRING && r->args >= h->strings_len)
+                    || (r->cgroup != SNAPSHOT_NO_STRING && r->cgroup >= h->strings_len)) {
+                        continue;
+                }
+
+                p->loaded = live ? SNAPSHOT_FIELDS & ~PF_THREADS : SNAPSHOT_FIELDS;
+                p->pid = r->pid;
+                p->tgid = r->tgid;
+                p->thread = (int)r->thread;
+                memcpy(p->pidstr, r->pidstr, sizeof(p->pidstr));
+                p->pidstr[sizeof(p->pidstr) - 1] = '\0';
+                if (live && !p->thread) {
+                        snprintf(p->dir, sizeof(p->dir), "%s", p->pidstr);
+                }
+                p->ppid = r->ppid;
+                p->uid = r->uid;
+                p->rss = r->rss;
+                p->utime = r->utime;
+                p->stime = r->stime;
+                p->start = r->start;
+                p->recent_cpu = -1.0;
+                p->user = pool_str(pool, r->user);
+                // proc keeps args as a mutable string it owns, but
+                // snapshot procs are never freed with proc_free().
+                p->cmd = pool_str(pool, r->cmd);
+                p->args = (char *)pool_str(pool, r->args);
+                p->cgroup = pool_str(pool, r->cgroup);
+
+                dyn_array_append(s->table, p);
+        }
+
+        return s;
+}
+
+snapshot *
+snapshot_open(const char *path)
+{
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return NULL;
+        snapshot *s = snapshot_open_fd(fd, 0);
+        int err = errno;
+        close(fd);
+        errno = err;
+        return s;
+}
+
+const proc_ptr_array *
+snapshot_procs(const snapshot *s)
+{
+        return &s->table;
+}
+
+uint64_t
+snapshot_generation(const snapshot *s)
+{
+        return ((const snapshot_header *)s->base)->generation;
+}
+
+void
+snapshot_close(snapshot *s)
+{
+        if (!s) return;
+        // Threads of live snapshots came from /proc.
+        for (size_t i = 0; i < s->table.len; ++i) {
+                proc *p = s->table.data[i];
+                for (size_t j = 0; j < p->threads.len; ++j) {
+                        proc_free(p->threads.data[j]);
+                }
+                dyn_array_free(p->threads);
+        }
+        munmap(s->base, s->len);
+        free(s->procs);
+        dyn_array_free(s->table);
+        free(s);
+}
@@ -0,0 +1,464 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+
+#include "fileio.h"
+#include "spawn.h"
+
+// One bit per possible pid (PID_MAX_LIMIT on 64 bit).
+#define PID_LIMIT (1 << 22)
+
+// Rescans of spawn_kill_tree() looking for new descendants.
+#define KILL_PASSES 16
+
+// Parents whose rate decayed below this and that have been
+// quiet for a minute are dropped when the map grows.
+#define STALE_RATE 0.01
+#define STALE_MS 60000
+
+typedef struct {
+        pid_t pid;        // 0 if the slot is empty
+        uint32_t total;
+        uint32_t last_ms; // of the last spawn, since epoch_ms
+        float rate;       // spawns per second as of last_ms
+} slot;
+
+static struct {
+        pthread_mutex_t lock;
+        slot *slots;
+        size_t cap; // power of two
+        size_t len;
+        uint64_t epoch_ms;
+
+        // spawn_observe()
+        uint8_t *seen; // pids in the previous table
+        uint64_t seen_start; // newest start time in it
+        int observed;
+
+        // The proc connector listener
+        int live;
+        int heard; // any fork event yet, under lock
+        int sock;
+        int stop[2];
+        pthread_t thread;
+} sp = { .lock = PTHREAD_MUTEX_INITIALIZER, .sock = -1 };
+
+static uint64_t
+mono_ms(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint32_t
+now_ms(void)
+{
+        return (uint32_t)(mono_ms() - sp.epoch_ms);
+}
+
+static double
+decayed(const slot *s,
+        uint32_t now)
+{
+        return s->rate * exp(-(double)(now - s->last_ms) / SPAWN_TAU_MS);
+}
+
+static size_t
+hash(pid_t pid)
+{
+        uint32_t k = (uint32_t)pid;
+        k ^= k >> 16;
+        k *= 0x7feb352d;
+        k ^= k >> 15;
+        k *= 0x846ca68b;
+        k ^= k >> 16;
+        return k;
+}
+
+static slot *
+probe(slot *slots,
+      size_t cap,
+      pid_t pid)
+{
+        size_t mask = cap - 1;
+        size_t i = hash(pid) & mask;
+        while (slots[i].pid && slots[i].pid != pid) i = (i + 1) & mask;
+        return &slots[i];
+}
+
+// Rehashes into a map twice the size of what is still live.
+static int
+grow(uint32_t now)
+{
+        size_t live = 0;
+        for (size_t i = 0; i < sp.cap; ++i) {
+                const slot *s = &sp.slots[i];
+                if (s->pid && (decayed(s, now) >= STALE_RATE || now - s->last_ms < STALE_MS)) ++live;
+        }
+
+        size_t cap = 1024;
+        while (cap < live * 4) cap *= 2;
+        slot *slots = calloc(cap, sizeof(*slots));
+        if (!slots) return -1;
+
+        for (size_t i = 0; i < sp.cap; ++i) {
+                const slot *s = &sp.slots[i];
+                if (s->pid && (decayed(s, now) >= STALE_RATE || now - s->last_ms < STALE_MS)) {
+                        *probe(slots, cap, s->pid) = *s;
+                }
+        }
+        free(sp.slots);
+        sp.slots = slots;
+        sp.cap = cap;
+        sp.len = live;
+        return 0;
+}
+
+// Caller holds sp.lock.
+static void
+record(pid_t parent,
+       uint32_t n,
+       uint32_t now)
+{
+        if ((sp.len + 1) * 4 > sp.cap * 3 && grow(now) == -1) return;
+
+        slot *s = probe(sp.slots, sp.cap, parent);
+        if (!s->pid) {
+                s->pid = parent;
+                sp.len++;
+        } else {
+                s->rate = (float)decayed(s, now);
+        }
+        s->rate += (float)(n * 1000.0 / SPAWN_TAU_MS);
+        s->total += n;
+        s->last_ms = now;
+}
+
+static int
+connector_send(int sock,
+               enum proc_cn_mcast_op op)
+{
+        struct {
+                struct nlmsghdr nl;
+                struct cn_msg cn;
+                enum proc_cn_mcast_op op;
+        } __attribute__((packed)) msg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.nl.nlmsg_len = sizeof(msg);
+        msg.nl.nlmsg_type = NLMSG_DONE;
+        msg.nl.nlmsg_pid = (uint32_t)getpid();
+        msg.cn.id.idx = CN_IDX_PROC;
+        msg.cn.id.val = CN_VAL_PROC;
+        msg.cn.len = sizeof(op);
+        msg.op = op;
+        return send(sock, &msg, sizeof(msg), 0) == (ssize_t)sizeof(msg) ? 0 : -1;
+}
+
+static int
+connector_open(void)
+{
+        int sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+        if (sock == -1) return -1;
+
+        struct sockaddr_nl addr = {
+                .nl_family = AF_NETLINK,
+                .nl_groups = CN_IDX_PROC,
+        };
+        // A fork storm can outrun us for a while, give the
+        // kernel room to queue events.
+        int size = 4 << 20;
+        if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == -1) {
+                setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        }
+
+        if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1
+            || connector_send(sock, PROC_CN_MCAST_LISTEN) == -1) {
+                close(sock);
+                return -1;
+        }
+        return sock;
+}
+
+static void *
+listen_run(void *arg)
+{
+        (void)arg;
+        static char buf[64 * 1024] __attribute__((aligned(NLMSG_ALIGNTO)));
+        struct pollfd pfd[2] = {
+                { .fd = sp.sock, .events = POLLIN },
+                { .fd = sp.stop[0], .events = POLLIN },
+        };
+
+        for (;;) {
+                if (poll(pfd, 2, -1) == -1) {
+                        if (errno == EINTR) continue;
+                        break;
+                }
+                if (pfd[1].revents) break;
+
+                // ENOBUFS means events were dropped, the counts
+                // are low but still right about who is forking.
+                ssize_t n = recv(sp.sock, buf, sizeof(buf), 0);
+                if (n <= 0) continue;
+
+                uint32_t now = now_ms();
+                pthread_mutex_lock(&sp.lock);
+                for (struct nlmsghdr *nl = (struct nlmsghdr *)buf; NLMSG_OK(nl, (size_t)n); nl = NLMSG_NEXT(nl, n)) {
+                        const struct cn_msg *cn = NLMSG_DATA(nl);
+                        if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC) continue;
+
+                        const struct proc_event *ev = (const struct proc_event *)cn->data;
+                        // New processes, not new threads.
+                        if (ev->what == PROC_EVENT_FORK
+                            && ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid) {
+                                record(ev->event_data.fork.parent_tgid, 1, now);
+                                sp.heard = 1;
+                        }
+                }
+                pthread_mutex_unlock(&sp.lock);
+        }
+        return NULL;
+}
+
+int
+spawn_start(void)
+{
+        if (sp.slots) return sp.live;
+
+        sp.epoch_ms = mono_ms();
+        sp.cap = 1024;
+        sp.slots = calloc(sp.cap, sizeof(*sp.slots));
+        if (!sp.slots) return 0;
+
+        if ((sp.sock = connector_open()) == -1) return 0;
+        if (pipe(sp.stop) == -1) {
+                close(sp.sock);
+                sp.sock = -1;
+                return 0;
+        }
+        if (pthread_create(&sp.thread, NULL, listen_run, NULL) != 0) {
+                close(sp.stop[0]);
+                close(sp.stop[1]);
+                close(sp.sock);
+                sp.sock = -1;
+                return 0;
+        }
+        sp.live = 1;
+        return 1;
+}
+
+static int
+bit(const uint8_t *bits,
+    pid_t pid)
+{
+        return pid > 0 && pid < PID_LIMIT && (bits[pid >> 3] & (1 << (pid & 7)));
+}
+
+static void
+set_bit(uint8_t *bits,
+        pid_t pid)
+{
+        if (pid > 0 && pid < PID_LIMIT) bits[pid >> 3] |= (uint8_t)(1 << (pid & 7));
+}
+
+void
+spawn_observe(const proc_ptr_array *procs)
+{
+        if (!sp.slots) return;
+        if (!sp.seen && !(sp.seen = calloc(PID_LIMIT / 8, 1))) return;
+
+        // A pid that was not there last time, or was but started
+        // after the newest process of last time, is a new process.
+        // Some containers accept the connector socket but never
+        // deliver anything, so keep diffing until it does.
+        uint64_t newest = 0;
+        uint32_t now = now_ms();
+        pthread_mutex_lock(&sp.lock);
+        for (size_t i = 0; sp.observed && !sp.heard && i < procs->len; ++i) {
+                const proc *p = procs->data[i];
+                int started = (p->loaded & PF_STAT) && p->start > sp.seen_start;
+                if ((!bit(sp.seen, p->pid) || started) && p->ppid > 0) {
+                        record(p->ppid, 1, now);
+                }
+        }
+        pthread_mutex_unlock(&sp.lock);
+
+        memset(sp.seen, 0, PID_LIMIT / 8);
+        for (size_t i = 0; i < procs->len; ++i) {
+                const proc *p = procs->data[i];
+                set_bit(sp.seen, p->pid);
+                if ((p->loaded & PF_STAT) && p->start > newest) newest = p->start;
+        }
+        sp.seen_start = newest;
+        sp.observed = 1;
+}
+
+static int
+rate_cmp(const void *a,
+         const void *b)
+{
+        double x = ((const spawn_parent *)a)->rate, y = ((const spawn_parent *)b)->rate;
+        return x < y ? 1 : x > y ? -1 : 0;
+}
+
+void
+spawn_top(spawn_parent_array *out)
+{
+        out->len = 0;
+        uint32_t now = now_ms();
+
+        pthread_mutex_lock(&sp.lock);
+        for (size_t i = 0; i < sp.cap; ++i) {
+                const slot *s = &sp.slots[i];
+                if (!s->pid) continue;
+                double rate = decayed(s, now);
+                if (rate < STALE_RATE) continue;
+                spawn_parent p = { s->pid, s->total, rate };
+                dyn_array_append(*out, p);
+        }
+        pthread_mutex_unlock(&sp.lock);
+
+        qsort(out->data, out->len, sizeof(*out->data), rate_cmp);
+}
+
+#define STAT_BATCH 256
+#define STAT_BUF 512
+
+// Every pid and its parent, from <proc root>/<pid>/stat. Reads
+// with FIO_SYNC whatever --reader says: this runs on the UI
+// thread while the refresher may be scanning.
+static int
+read_parents(pid_array *pids,
+             pid_array *ppids)
+{
+        static char bufs[STAT_BATCH][STAT_BUF];
+        char paths[STAT_BATCH][24];
+        file_read reqs[STAT_BATCH];
+
+        pids->len = ppids->len = 0;
+        if (proc_pids(pids) == -1) return -1;
+
+        for (size_t i = 0; i < pids->len; i += STAT_BATCH) {
+                size_t n = pids->len - i < STAT_BATCH ? pids->len - i : STAT_BATCH;
+                for (size_t j = 0; j < n; ++j) {
+                        snprintf(paths[j], sizeof(paths[j]), "%d/stat", (int)pids->data[i + j]);
+                        reqs[j] = (file_read) { .path = paths[j], .buf = bufs[j], .cap = STAT_BUF };
+                }
+                fileio_read(FIO_SYNC, proc_root_fd(), reqs, n);
+
+                // The ppid is the second field after the command,
+                // which may itself contain spaces and parens.
+                for (size_t j = 0; j < n; ++j) {
+                        pid_t ppid = 0;
+                        const char *rp = reqs[j].len > 0 ? strrchr(bufs[j], ')') : NULL;
+                        if (rp) sscanf(rp + 1, " %*c %d", &ppid);
+                        dyn_array_append(*ppids, ppid);
+                }
+        }
+        return 0;
+}
+
+int
+spawn_kill_tree(pid_t root)
+{
+        if (kill(root, SIGSTOP) == -1) return -1;
+
+        uint8_t *stopped = calloc(PID_LIMIT / 8, 1);
+        pid_array tree = dyn_array_empty(pid_array);
+        if (!stopped) {
+                kill(root, SIGKILL);
+                return 1;
+        }
+        set_bit(stopped, root);
+        dyn_array_append(tree, root);
+
+        // Stopped processes cannot fork, so each pass can only
+        // find the children forked before their parent stopped.
+        pid_array pids = dyn_array_empty(pid_array), ppids = dyn_array_empty(pid_array);
+        for (int pass = 0; pass < KILL_PASSES; ++pass) {
+                if (read_parents(&pids, &ppids) == -1) break;
+
+                size_t before = tree.len;
+                for (int grew = 1; grew; ) {
+                        grew = 0;
+                        for (size_t i = 0; i < pids.len; ++i) {
+                                pid_t pid = pids.data[i];
+                                if (bit(stopped, pid) || !bit(stopped, ppids.data[i])) continue;
+                                kill(pid, SIGSTOP);
+                                set_bit(stopped, pid);
+                                dyn_array_append(tree, pid);
+                                grew = 1;
+                        }
+                }
+                if (tree.len == before) break;
+        }
+        dyn_array_free(pids);
+        dyn_array_free(ppids);
+
+        int killed = 0;
+        for (size_t i = 0; i < tree.len; ++i) {
+                killed += kill(tree.data[i], SIGKILL) == 0;
+        }
+
+        dyn_array_free(tree);
+        free(stopped);
+        return killed;
+}
+
+void
+spawn_stop(void)
+{
+        if (sp.live) {
+                char byte = 0;
+                while (write(sp.stop[1], &byte, 1) == -1 && errno == EINTR);
+                pthread_join(sp.thread, NULL);
+                connector_send(sp.sock, PROC_CN_MCAST_IGNORE);
+                close(sp.sock);
+                close(sp.stop[0]);
+                close(sp.stop[1]);
+                sp.sock = -1;
+                sp.live = 0;
+        }
+        free(sp.slots);
+        free(sp.seen);
+        sp.slots = NULL;
+        sp.seen = NULL;
+        sp.cap = sp.len = 0;
+        sp.observed = 0;
+        sp.heard = 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+#define BUCKETS 64
+
+typedef struct {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t not_min; // ~min, so that zero means none yet
+        uint64_t max;
+        uint64_t buckets[BUCKETS]; // bucket i holds values in [2^(i-1), 2^i)
+} histogram;
+
+static const struct {
+        const char *name;
+        int time; // nanoseconds, printed as microseconds
+} metrics[ST__COUNT] = {
+        [ST_SCAN]                = {"scan",                1},
+        [ST_SCAN_PROC]           = {"scan_proc",           1},
+        [ST_GETPWUID]            = {"getpwuid",            1},
+        [ST_FILTER]              = {"filter",              1},
+        [ST_RENDER]              = {"render",              1},
+        [ST_FRAME_ALLOCS]        = {"frame_allocs",        0},
+        [ST_FRAME_BYTES]         = {"frame_bytes",         0},
+        [ST_FRAME_FREES]         = {"frame_frees",         0},
+        [ST_FRAME_SCAN_SYSCALLS] = {"frame_scan_syscalls", 0},
+};
+
+int stats_enabled = 0;
+
+static histogram hists[ST__COUNT];
+
+// Touched from the port scanner's threads too.
+static uint64_t frame_allocs = 0;
+static uint64_t frame_bytes = 0;
+static uint64_t frame_frees = 0;
+static uint64_t frame_scan_syscalls = 0; // proc_scan() and proc_load() only
+
+uint64_t
+stats_now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void
+atomic_max(uint64_t *p,
+           uint64_t value)
+{
+        uint64_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+        while (value > cur
+               && !__atomic_compare_exchange_n(p, &cur, value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// Lock free, the background scanner records from its own thread.
+void
+stats_record(stats_metric m,
+             uint64_t value)
+{
+        histogram *h = &hists[m];
+        size_t b = value ? 64 - (size_t)__builtin_clzll(value) : 0;
+        if (b >= BUCKETS) b = BUCKETS - 1;
+
+        atomic_max(&h->not_min, ~value);
+        atomic_max(&h->max, value);
+        __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&h->sum, value, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&h->buckets[b], 1, __ATOMIC_RELAXED);
+}
+
+void
+stats_count_syscalls(uint64_t n)
+{
+        __atomic_fetch_add(&frame_scan_syscalls, n, __ATOMIC_RELAXED);
+}
+
+void
+stats_frame_end(void)
+{
+        if (!stats_enabled) return;
+        stats_record(ST_FRAME_ALLOCS, __atomic_exchange_n(&frame_allocs, 0, __ATOMIC_RELAXED));
+        stats_record(ST_FRAME_BYTES, __atomic_exchange_n(&frame_bytes, 0, __ATOMIC_RELAXED));
+        stats_record(ST_FRAME_FREES, __atomic_exchange_n(&frame_frees, 0, __ATOMIC_RELAXED));
+        stats_record(ST_FRAME_SCAN_SYSCALLS, __atomic_exchange_n(&frame_scan_syscalls, 0, __ATOMIC_RELAXED));
+}
+
+// Upper bound of the bucket holding the p-th percentile.
+static uint64_t
+percentile(const histogram *h,
+           double p)
+{
+        if (h->count == 0) return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * (double)h->count + 0.999999);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+                seen += h->buckets[b];
+                if (seen >= rank) {
+                        uint64_t hi = b ? (1ull << b) - 1 : 0;
+                        return hi < h->max ? hi : h->max;
+                }
+        }
+        return h->max;
+}
+
+void
+stats_status_line(char *buf,
+                  size_t n)
+{
+        const histogram *frames = &hists[ST_FRAME_ALLOCS];
+        snprintf(buf, n,
+                 "scan p50 %.1fms | filter p50 %.2fms p99 %.2fms | render p50 %.2fms | "
+                 "allocs/frame %.1f (%.0fB) | scan syscalls/frame %.1f",
+                 percentile(&hists[ST_SCAN], 50) / 1e6,
+                 percentile(&hists[ST_FILTER], 50) / 1e6,
+                 percentile(&hists[ST_FILTER], 99) / 1e6,
+                 percentile(&hists[ST_RENDER], 50) / 1e6,
+                 frames->count ? (double)frames->sum / frames->count : 0.0,
+                 frames->count ? (double)hists[ST_FRAME_BYTES].sum / frames->count : 0.0,
+                 frames->count ? (double)hists[ST_FRAME_SCAN_SYSCALLS].sum / frames->count : 0.0);
+}
+
+// One JSON object, so runs can be collected and compared.
+void
+stats_dump(FILE *out)
+{
+        fprintf(out, "{");
+        for (size_t m = 0; m < ST__COUNT; ++m) {
+                const histogram *h = &hists[m];
+                double scale = metrics[m].time ? 1e3 : 1.0;
+
+                fprintf(out, "%s\"%s%s\":{\"count\":%llu,\"sum\":%.3f,\"min\":%.3f,\"max\":%.3f,"
+                        "\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"buckets\":[",
+                        m ? "," : "", metrics[m].name, metrics[m].time ? "_us" : "",
+                        (unsigned long long)h->count, h->sum / scale,
+                        h->count ? ~h->not_min / scale : 0.0, h->max / scale,
+                        percentile(h, 50) / scale, percentile(h, 95) / scale, percentile(h, 99) / scale);
+
+                // Trailing empty buckets are left out.
+                size_t last = 0;
+                for (size_t b = 0; b < BUCKETS; ++b) {
+                        if (h->buckets[b]) last = b + 1;
+                }
+                for (size_t b = 0; b < last; ++b) {
+                        fprintf(out, "%s%llu", b ? "," : "", (unsigned long long)h->buckets[b]);
+                }
+                fprintf(out, "]}");
+        }
+        fprintf(out, "}\n");
+}
+
+#ifdef ALLOC_STATS
+
+/* Count heap allocations by wrapping the allocator. glibc
+ * exports its own entry points under these names, and calls
+ * from inside it (strdup, getpwuid, ...) come through here too.
+ * Every entry point that allocates is wrapped, so no pointer
+ * from one allocator is handed to another. */
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void __libc_free(void *);
+extern void *__libc_memalign(size_t, size_t);
+
+static inline void
+count_alloc(size_t n)
+{
+        if (!stats_enabled) return;
+        __atomic_fetch_add(&frame_allocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&frame_bytes, n, __ATOMIC_RELAXED);
+}
+
+void *
+malloc(size_t n)
+{
+        count_alloc(n);
+        return __libc_malloc(n);
+}
+
+void *
+calloc(size_t nmemb,
+       size_t n)
+{
+        count_alloc(nmemb * n);
+        return __libc_calloc(nmemb, n);
+}
+
+void *
+realloc(void *ptr,
+        size_t n)
+{
+        count_alloc(n);
+        return __libc_realloc(ptr, n);
+}
+
+void
+free(void *ptr)
+{
+        if (ptr && stats_enabled) __atomic_fetch_add(&frame_frees, 1, __ATOMIC_RELAXED);
+        __libc_free(ptr);
+}
+
+void *
+memalign(size_t align,
+         size_t n)
+{
+        count_alloc(n);
+        return __libc_memalign(align, n);
+}
+
+void *
+aligned_alloc(size_t align,
+              size_t n)
+{
+        count_alloc(n);
+        return __libc_memalign(align, n);
+}
+
+int
+posix_memalign(void **out,
+               size_t align,
+               size_t n)
+{
+        if (align % sizeof(void *) || (align & (align - 1))) return EINVAL;
+        count_alloc(n);
+        void *p = __libc_memalign(align, n);
+        if (!p) return ENOMEM;
+        *out = p;
+        return 0;
+}
+
+#endif // ALLOC_STATS
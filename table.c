@@ -0,0 +1,544 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "table.h"
+#include "daemon.h"
+#include "stats.h"
+
+static _Atomic(proc_table *) current = NULL;
+static _Atomic(proc_table *) hazard = NULL; // what the reader holds
+static _Atomic(uint32_t) wanted = 0;
+static _Atomic(int) hurry = 0; // rescan now, the UI waits for fields
+
+// Pids whose threads the UI shows. Handed over whole: the UI
+// swaps a new array in, the refresher swaps it out, and whoever
+// gets the other one back frees it.
+static _Atomic(pid_array *) expanded_box = NULL;
+
+// What the UI tells the scheduler, see table_note_*().
+static _Atomic(uint64_t) last_input_ms = 0;
+static _Atomic(int) unfocused = 0;
+static _Atomic(uint64_t) charged_ns = 0;
+
+// Writer only.
+static proc_table *retired = NULL;
+static uint64_t next_generation = 1;
+static trigram_index *spare_index = NULL; // of a freed table, for reuse
+
+// Refresh scheduling
+#define ACTIVE_MS 2000      // since the last key, refresh faster
+#define IDLE_MS 60000       // since the last key, refresh slower
+#define ACTIVE_DIVISOR 4
+#define IDLE_FACTOR 8
+#define MAX_STRETCH 4       // after quiet scans
+#define MIN_INTERVAL_MS 100
+#define MAX_INTERVAL_MS 60000
+#define CHURN_PIDS (1 << 22)
+
+static struct {
+        int running;
+        pthread_t thread;
+        int stop[2]; // pipe, written to stop the thread
+        int wake[2]; // pipe, written when the user comes back
+        unsigned interval_ms;
+        int index;
+        const char *socket;
+        uint64_t daemon_generation;
+
+        // Refresher only
+        double budget;       // fraction of one CPU, 0 for none
+        double cost_ns;      // moving average, CPU per refresh
+        unsigned stretch;    // 1, 2 or 4 after scans that changed nothing
+        uint8_t *pids;       // bitmap of the last table
+        size_t npids;        // bits set in it
+        pid_array expanded;  // from expanded_box
+        _Atomic(unsigned) current_ms;
+} refresher = { .stop = {-1, -1}, .wake = {-1, -1}, .budget = TABLE_CPU_BUDGET, .stretch = 1 };
+
+// A refresh mostly sees the same trigrams again, so the index of
+// a freed table is rebuilt in place rather than from scratch.
+static trigram_index *
+build_index(const proc_ptr_array *procs)
+{
+        trigram_index *idx = spare_index;
+        if (!idx) return trigram_build(procs);
+        spare_index = NULL;
+        trigram_rebuild(idx, procs);
+        return idx;
+}
+
+// What every proc of `t` has loaded, so the UI can tell whether
+// it would have to load something itself.
+static uint32_t
+common_fields(const proc_table *t)
+{
+        uint32_t fields = ~0u;
+        for (size_t i = 0; i < t->procs.len; ++i) {
+                fields &= t->procs.data[i]->loaded;
+        }
+        return fields;
+}
+
+proc_table *
+table_scan(uint32_t fields,
+           int index)
+{
+        proc_table *t = calloc(1, sizeof(*t));
+        if (!t) return NULL;
+
+        if (proc_scan(&t->procs, fields) == -1) {
+                table_free(t);
+                return NULL;
+        }
+        t->uptime = proc_uptime();
+        t->fields = common_fields(t);
+        if (index) {
+                t->index = build_index(&t->procs);
+        }
+        return t;
+}
+
+proc_table *
+table_from_snapshot(snapshot *s,
+                    uint32_t fields,
+                    int index)
+{
+        proc_table *t = calloc(1, sizeof(*t));
+        if (!t) {
+                snapshot_close(s);
+                return NULL;
+        }
+
+        // Borrow the procs, they stay in the mapping. A live
+        // snapshot has no threads, load them if asked to; the
+        // procs that are gone by now are left out.
+        t->snapshot = s;
+        t->uptime = proc_uptime();
+        const proc_ptr_array *procs = snapshot_procs(s);
+        for (size_t i = 0; i < procs->len; ++i) {
+                if (!proc_load(procs->data[i], fields)) continue;
+                dyn_array_append(t->procs, procs->data[i]);
+        }
+        t->fields = common_fields(t);
+        if (index) {
+                t->index = build_index(&t->procs);
+        }
+        return t;
+}
+
+void
+table_free(proc_table *t)
+{
+        if (!t) return;
+        if (t->snapshot) {
+                snapshot_close(t->snapshot);
+        } else {
+                for (size_t i = 0; i < t->procs.len; ++i) {
+                        proc_free(t->procs.data[i]);
+                }
+        }
+        dyn_array_free(t->procs);
+        trigram_free(t->index);
+        free(t);
+}
+
+static void
+reclaim(void)
+{
+        proc_table *held = atomic_load(&hazard);
+        proc_table **link = &retired;
+        while (*link) {
+                proc_table *t = *link;
+                if (t == held) {
+                        link = &t->retired;
+                        continue;
+                }
+                *link = t->retired;
+                if (!spare_index) {
+                        spare_index = t->index;
+                        t->index = NULL;
+                }
+                table_free(t);
+        }
+}
+
+void
+table_publish(proc_table *t)
+{
+        t->generation = next_generation++;
+        proc_table *old = atomic_exchange(&current, t);
+        if (old) {
+                old->retired = retired;
+                retired = old;
+        }
+        reclaim();
+}
+
+int
+table_newer(const proc_table *t)
+{
+        return atomic_load(&current) != t;
+}
+
+proc_table *
+table_acquire(void)
+{
+        // Once the hazard pointer is set, a table that is still
+        // current cannot be freed; check it still is.
+        proc_table *t;
+        do {
+                t = atomic_load(&current);
+                atomic_store(&hazard, t);
+        } while (t != atomic_load(&current));
+        return t;
+}
+
+static void
+wake_refresher(void)
+{
+        char byte = 0;
+        while (write(refresher.wake[1], &byte, 1) == -1 && errno == EINTR);
+}
+
+void
+table_want_fields(uint32_t fields)
+{
+        uint32_t prev = atomic_exchange_explicit(&wanted, fields, memory_order_relaxed);
+
+        // Something new that the table does not have, do not make
+        // the user sit out the interval for it.
+        proc_table *t = atomic_load(&current);
+        if (refresher.running && (fields & ~prev) && t && (fields & ~t->fields)) {
+                atomic_store(&hurry, 1);
+                wake_refresher();
+        }
+}
+
+void
+table_want_threads(const pid_t *pids,
+                   size_t n)
+{
+        if (!refresher.running) return;
+
+        pid_array *box = malloc(sizeof(*box));
+        if (!box) return;
+        *box = dyn_array_empty(pid_array);
+        for (size_t i = 0; i < n; ++i) {
+                dyn_array_append(*box, pids[i]);
+        }
+
+        pid_array *old = atomic_exchange(&expanded_box, box);
+        if (old) {
+                dyn_array_free(*old);
+                free(old);
+        }
+}
+
+int
+table_ready(const proc_table *t,
+            uint32_t fields)
+{
+        return !refresher.running || !(fields & ~t->fields);
+}
+
+// Loads the threads the UI is going to show before `t` is
+// published, so that it does not have to.
+static void
+load_expanded(proc_table *t)
+{
+        pid_array *box = atomic_exchange(&expanded_box, NULL);
+        if (box) {
+                dyn_array_free(refresher.expanded);
+                refresher.expanded = *box;
+                free(box);
+        }
+
+        for (size_t i = 0; refresher.expanded.len && i < t->procs.len; ++i) {
+                proc *p = t->procs.data[i];
+                for (size_t j = 0; j < refresher.expanded.len; ++j) {
+                        if (refresher.expanded.data[j] != p->pid) continue;
+                        proc_load(p, PF_THREADS);
+                        break;
+                }
+        }
+}
+
+static proc_table *
+from_daemon(int rush)
+{
+        int fd = daemon_attach(refresher.socket);
+        if (fd == -1) {
+                // It went away, so scan ourselves
+                return table_scan(PF_DEFAULT | atomic_load(&wanted), refresher.index);
+        }
+
+        snapshot *s = snapshot_open_fd(fd, 1);
+        close(fd);
+        if (!s) return NULL;
+
+        // The UI waits for fields only a new table can bring
+        if (snapshot_generation(s) == refresher.daemon_generation && !rush) {
+                snapshot_close(s);
+                return NULL;
+        }
+        refresher.daemon_generation = snapshot_generation(s);
+        return table_from_snapshot(s, PF_DEFAULT | atomic_load(&wanted), refresher.index);
+}
+
+static uint64_t
+clock_ns(clockid_t clock)
+{
+        struct timespec ts;
+        clock_gettime(clock, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t
+now_ms(void)
+{
+        return clock_ns(CLOCK_MONOTONIC) / 1000000;
+}
+
+// How many pids of `t` are new or gone since the last call.
+static size_t
+churn(const proc_table *t)
+{
+        if (!refresher.pids && !(refresher.pids = calloc(CHURN_PIDS / 8, 1))) return 1;
+
+        size_t changed = 0, kept = 0;
+        for (size_t i = 0; i < t->procs.len; ++i) {
+                pid_t pid = t->procs.data[i]->pid;
+                if (pid <= 0 || pid >= CHURN_PIDS) continue;
+                if (refresher.pids[pid >> 3] & (1 << (pid & 7))) ++kept;
+                else ++changed;
+        }
+        changed += refresher.npids - kept;
+
+        memset(refresher.pids, 0, CHURN_PIDS / 8);
+        refresher.npids = 0;
+        for (size_t i = 0; i < t->procs.len; ++i) {
+                pid_t pid = t->procs.data[i]->pid;
+                if (pid <= 0 || pid >= CHURN_PIDS || (refresher.pids[pid >> 3] & (1 << (pid & 7)))) continue;
+                refresher.pids[pid >> 3] |= (uint8_t)(1 << (pid & 7));
+                refresher.npids++;
+        }
+        return changed;
+}
+
+// The wait before the next refresh. The user decides how fast
+// it should be, the budget how fast it may be.
+static unsigned
+next_interval(void)
+{
+        uint64_t idle = now_ms() - atomic_load(&last_input_ms);
+        uint64_t ms = refresher.interval_ms;
+
+        if (atomic_load(&unfocused) || idle >= IDLE_MS) {
+                ms *= IDLE_FACTOR;
+        } else if (idle < ACTIVE_MS) {
+                ms /= ACTIVE_DIVISOR;
+        } else {
+                ms *= refresher.stretch;
+        }
+        if (ms < MIN_INTERVAL_MS) ms = MIN_INTERVAL_MS;
+        if (ms > MAX_INTERVAL_MS) ms = MAX_INTERVAL_MS;
+
+        // Spending cost_ns per refresh, refreshing every
+        // cost_ns / budget uses exactly the budget.
+        if (refresher.budget > 0) {
+                uint64_t floor = (uint64_t)(refresher.cost_ns / refresher.budget / 1000000);
+                if (ms < floor) ms = floor;
+        }
+        return (unsigned)ms;
+}
+
+static void *
+refresher_run(void *arg)
+{
+        (void)arg;
+        struct pollfd pfd[2] = {
+                { .fd = refresher.stop[0], .events = POLLIN },
+                { .fd = refresher.wake[0], .events = POLLIN },
+        };
+        uint64_t last = now_ms();
+        for (;;) {
+                unsigned interval = atomic_load(&hurry) ? 0 : next_interval();
+                atomic_store(&refresher.current_ms, interval);
+                uint64_t elapsed = now_ms() - last;
+                int timeout = elapsed >= interval ? 0 : (int)(interval - elapsed);
+
+                int r = poll(pfd, 2, timeout);
+                if (r < 0 && errno == EINTR) continue;
+                if (r < 0 || pfd[0].revents) break;
+                if (pfd[1].revents) {
+                        // Work out the new interval from the same start
+                        char buf[64];
+                        while (read(refresher.wake[0], buf, sizeof(buf)) > 0);
+                        continue;
+                }
+
+                last = now_ms();
+                int rush = atomic_exchange(&hurry, 0);
+                uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+                uint64_t t0 = STATS_BEGIN();
+                proc_table *t = refresher.socket
+                        ? from_daemon(rush)
+                        : table_scan(PF_DEFAULT | atomic_load(&wanted), refresher.index);
+                if (!t) continue;
+                load_expanded(t);
+                STATS_END(ST_SCAN, t0);
+
+                if (churn(t) == 0) {
+                        if (refresher.stretch < MAX_STRETCH) refresher.stretch *= 2;
+                } else {
+                        refresher.stretch = 1;
+                }
+                table_publish(t);
+
+                // What the UI spent on the previous table is the best
+                // guess for what it spends on this one.
+                double cost = (double)(clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu)
+                        + (double)atomic_exchange(&charged_ns, 0);
+                refresher.cost_ns = refresher.cost_ns ? refresher.cost_ns * 0.75 + cost * 0.25 : cost;
+        }
+        return NULL;
+}
+
+void
+table_set_cpu_budget(double fraction)
+{
+        refresher.budget = fraction;
+}
+
+unsigned
+table_refresh_interval(void)
+{
+        return atomic_load(&refresher.current_ms);
+}
+
+void
+table_note_input(void)
+{
+        uint64_t now = now_ms();
+        uint64_t prev = atomic_exchange(&last_input_ms, now);
+
+        // Coming back from idle, do not sit out a long wait
+        if (refresher.running && now - prev >= ACTIVE_MS) {
+                wake_refresher();
+        }
+}
+
+void
+table_note_focus(int focused)
+{
+        int was = atomic_exchange(&unfocused, !focused);
+        if (refresher.running && was != !focused) {
+                wake_refresher();
+        }
+}
+
+void
+table_charge(uint64_t ns)
+{
+        atomic_fetch_add(&charged_ns, ns);
+}
+
+int
+table_refresher_start(unsigned interval_ms,
+                      int index,
+                      const char *daemon_socket)
+{
+        if (refresher.running || pipe(refresher.stop) == -1) {
+                return -1;
+        }
+        if (pipe2(refresher.wake, O_CLOEXEC | O_NONBLOCK) == -1) {
+                close(refresher.stop[0]);
+                close(refresher.stop[1]);
+                return -1;
+        }
+        atomic_store(&last_input_ms, now_ms());
+
+        refresher.interval_ms = interval_ms;
+        refresher.index = index;
+        refresher.socket = daemon_socket;
+
+        proc_table *t = atomic_load(&current);
+        if (t && t->snapshot) {
+                refresher.daemon_generation = snapshot_generation(t->snapshot);
+        }
+
+        if (t) churn(t);
+
+        if (pthread_create(&refresher.thread, NULL, refresher_run, NULL) != 0) {
+                close(refresher.stop[0]);
+                close(refresher.stop[1]);
+                close(refresher.wake[0]);
+                close(refresher.wake[1]);
+                return -1;
+        }
+        refresher.running = 1;
+        return 0;
+}
+
+void
+table_refresher_stop(void)
+{
+        if (!refresher.running) return;
+
+        char byte = 0;
+        while (write(refresher.stop[1], &byte, 1) == -1 && errno == EINTR);
+        pthread_join(refresher.thread, NULL);
+        close(refresher.stop[0]);
+        close(refresher.stop[1]);
+        close(refresher.wake[0]);
+        close(refresher.wake[1]);
+        free(refresher.pids);
+        refresher.pids = NULL;
+        refresher.npids = 0;
+        dyn_array_free(refresher.expanded);
+        pid_array *box = atomic_exchange(&expanded_box, NULL);
+        if (box) {
+                dyn_array_free(*box);
+                free(box);
+        }
+        refresher.running = 0;
+}
+
+void
+table_cleanup(void)
+{
+        table_refresher_stop();
+        atomic_store(&hazard, NULL);
+        reclaim();
+        table_free(atomic_exchange(&current, NULL));
+        trigram_free(spare_index);
+        spare_index = NULL;
+}
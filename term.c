@@ -0,0 +1,283 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <curses.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "term.h"
+#include "dyn_array.h"
+
+DYN_ARRAY_TYPE(char, byte_array);
+
+static struct term_state {
+        int open;
+        int fd;
+        int raw;
+        struct termios saved;
+        int w, h;
+        int row;          // where the cursor is, 0 is the first line of the area
+        byte_array out;   // the frame being built
+        char **lines;     // what each row shows now, NULL if unknown
+        unsigned char pending[64]; // read but not yet returned
+        size_t npending;
+} t = { .fd = -1 };
+
+static void
+put(const char *s,
+    size_t n)
+{
+        for (size_t i = 0; i < n; ++i) {
+                dyn_array_append(t.out, s[i]);
+        }
+}
+
+static void
+put_str(const char *s)
+{
+        put(s, strlen(s));
+}
+
+static void
+move_to(int row)
+{
+        char buf[16];
+        if (row > t.row) {
+                snprintf(buf, sizeof(buf), "\x1b[%dB", row - t.row);
+                put_str(buf);
+        } else if (row < t.row) {
+                snprintf(buf, sizeof(buf), "\x1b[%dA", t.row - row);
+                put_str(buf);
+        }
+        put_str("\r");
+        t.row = row;
+}
+
+int
+term_open(int rows,
+          int headless,
+          int *w,
+          int *h)
+{
+        if (t.open) return -1;
+
+        if (headless) {
+                t.fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+                const char *cols = getenv("COLUMNS");
+                t.w = cols && atoi(cols) > 0 ? atoi(cols) : 80;
+                t.h = rows;
+        } else {
+                t.fd = open("/dev/tty", O_RDWR | O_CLOEXEC);
+                if (t.fd == -1 || tcgetattr(t.fd, &t.saved) == -1) {
+                        if (t.fd != -1) close(t.fd);
+                        t.fd = -1;
+                        return -1;
+                }
+
+                // Like cfmakeraw(), but keep output processing.
+                struct termios raw = t.saved;
+                raw.c_iflag &= ~(unsigned)(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+                raw.c_lflag &= ~(unsigned)(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+                raw.c_cflag |= CS8;
+                raw.c_cc[VMIN] = 1;
+                raw.c_cc[VTIME] = 0;
+                tcsetattr(t.fd, TCSAFLUSH, &raw);
+                t.raw = 1;
+
+                struct winsize ws;
+                if (ioctl(t.fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col && ws.ws_row) {
+                        t.w = ws.ws_col;
+                        t.h = rows < ws.ws_row ? rows : ws.ws_row - 1;
+                } else {
+                        t.w = 80;
+                        t.h = rows;
+                }
+        }
+        if (t.h < 3) t.h = 3;
+        if (t.fd == -1) return -1;
+
+        t.open = 1;
+        t.lines = calloc((size_t)t.h, sizeof(char *));
+
+        // Make room below the prompt, scrolling if need be, then
+        // go back to the top of it.
+        t.out.len = 0;
+        put_str("\x1b[?25l" TERM_FOCUS_ON);
+        for (int i = 0; i < t.h - 1; ++i) put_str("\n");
+        t.row = t.h - 1;
+        move_to(0);
+        term_flush();
+
+        *w = t.w;
+        *h = t.h;
+        return 0;
+}
+
+void
+term_close(void)
+{
+        if (!t.open) return;
+
+        t.out.len = 0;
+        move_to(0);
+        put_str("\x1b[J\x1b[?25h" TERM_FOCUS_OFF);
+        term_flush();
+
+        if (t.raw) tcsetattr(t.fd, TCSAFLUSH, &t.saved);
+        close(t.fd);
+        for (int i = 0; i < t.h; ++i) free(t.lines[i]);
+        free(t.lines);
+        dyn_array_free(t.out);
+        t = (struct term_state) { .fd = -1 };
+}
+
+void
+term_line(int row,
+          int highlight,
+          const char *s)
+{
+        if (!t.open || row < 0 || row >= t.h) return;
+
+        // One column short of the edge, so the terminal never wraps.
+        size_t n = strnlen(s, (size_t)(t.w > 1 ? t.w - 1 : 1));
+
+        char *prev = t.lines[row];
+        if (prev && prev[0] == (highlight ? 'h' : 'n')
+            && !strncmp(prev + 1, s, n) && prev[n + 1] == '\0') {
+                return;
+        }
+
+        free(prev);
+        if ((t.lines[row] = malloc(n + 2))) {
+                t.lines[row][0] = highlight ? 'h' : 'n';
+                memcpy(t.lines[row] + 1, s, n);
+                t.lines[row][n + 1] = '\0';
+        }
+
+        move_to(row);
+        if (highlight) put_str("\x1b[30;47m");
+        put(s, n);
+        if (highlight) put_str("\x1b[0m");
+        put_str("\x1b[K");
+}
+
+void
+term_invalidate(void)
+{
+        for (int i = 0; t.open && i < t.h; ++i) {
+                free(t.lines[i]);
+                t.lines[i] = NULL;
+        }
+}
+
+void
+term_flush(void)
+{
+        size_t off = 0;
+        while (off < t.out.len) {
+                ssize_t n = write(t.fd, t.out.data + off, t.out.len - off);
+                if (n <= 0) break;
+                off += (size_t)n;
+        }
+        t.out.len = 0;
+}
+
+#define ESC_WAIT_MS 100
+
+static int
+take(size_t n)
+{
+        int c = t.pending[0];
+        memmove(t.pending, t.pending + n, t.npending - n);
+        t.npending -= n;
+        return c;
+}
+
+// Reads whatever is available within `timeout_ms` after
+// the bytes already pending.
+static int
+fill(int timeout_ms)
+{
+        struct pollfd pfd = { .fd = t.fd, .events = POLLIN };
+        if (t.npending == sizeof(t.pending)) return 0;
+        if (poll(&pfd, 1, timeout_ms) <= 0) return 0;
+        ssize_t n = read(t.fd, t.pending + t.npending, sizeof(t.pending) - t.npending);
+        if (n <= 0) return 0;
+        t.npending += (size_t)n;
+        return 1;
+}
+
+int
+term_getkey(int timeout_ms)
+{
+        if (t.npending == 0 && !fill(timeout_ms)) return ERR;
+
+        // An escape sequence can arrive split across reads, give
+        // the rest of it a moment before taking ESC on its own.
+        while (t.pending[0] == 27 && t.npending < 3 && fill(ESC_WAIT_MS))
+                ;
+
+        // Arrows are ESC [ A or, in application mode, ESC O A.
+        if (t.pending[0] == 27 && t.npending >= 3 && t.pending[1] == 'O') {
+                unsigned char c = t.pending[2];
+                take(3);
+                if (c == 'A') return KEY_UP;
+                if (c == 'B') return KEY_DOWN;
+                return ERR;
+        }
+
+        // A CSI sequence is ESC [, parameter and intermediate bytes
+        // (0x20-0x3f), then one final byte (0x40-0x7e). Focus
+        // reports are ESC [ I and ESC [ O. Anything else, e.g. page
+        // up (ESC [ 5 ~) or delete (ESC [ 3 ~), is read to its end
+        // and dropped rather than typed into the search box.
+        if (t.pending[0] == 27 && t.npending >= 2 && t.pending[1] == '[') {
+                size_t end = 2;
+                for (;;) {
+                        while (end < t.npending && t.pending[end] >= 0x20 && t.pending[end] < 0x40) ++end;
+                        if (end < t.npending || !fill(ESC_WAIT_MS)) break;
+                }
+                if (end == t.npending || t.pending[end] < 0x40 || t.pending[end] > 0x7e) {
+                        take(end); // cut short
+                        return ERR;
+                }
+
+                unsigned char c = t.pending[end];
+                int params = end > 2;
+                take(end + 1);
+                if (c == 'A') return KEY_UP;
+                if (c == 'B') return KEY_DOWN;
+                if (!params && c == 'I') return KEY_FOCUS_IN;
+                if (!params && c == 'O') return KEY_FOCUS_OUT;
+                return ERR;
+        }
+
+        int c = take(1);
+        if (c == 127 || c == 8) return KEY_BACKSPACE;
+        if (c == '\r') return '\n';
+        return c;
+}
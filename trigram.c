@@ -0,0 +1,220 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trigram.h"
+
+typedef struct {
+        uint32_t key; // trigram + 1, 0 means the slot is empty
+        u32_array postings;
+} slot;
+
+struct trigram_index {
+        slot *slots;
+        size_t cap; // power of two
+        size_t len; // used slots
+};
+
+#define INITIAL_CAP 4096
+
+static uint32_t
+trigram_of(const char *s)
+{
+        return ((uint32_t)(unsigned char)tolower((unsigned char)s[0]) << 16)
+                | ((uint32_t)(unsigned char)tolower((unsigned char)s[1]) << 8)
+                | (uint32_t)(unsigned char)tolower((unsigned char)s[2]);
+}
+
+static size_t
+hash(uint32_t key)
+{
+        key ^= key >> 16;
+        key *= 0x7feb352d;
+        key ^= key >> 15;
+        key *= 0x846ca68b;
+        key ^= key >> 16;
+        return key;
+}
+
+static slot *
+lookup(const trigram_index *idx,
+       uint32_t tri)
+{
+        uint32_t key = tri + 1;
+        size_t mask = idx->cap - 1;
+        for (size_t i = hash(key) & mask; ; i = (i + 1) & mask) {
+                if (idx->slots[i].key == key) return &idx->slots[i];
+                if (idx->slots[i].key == 0) return NULL;
+        }
+}
+
+static void
+grow(trigram_index *idx)
+{
+        size_t old_cap = idx->cap;
+        slot *old = idx->slots;
+
+        idx->cap = old_cap ? old_cap * 2 : INITIAL_CAP;
+        idx->slots = calloc(idx->cap, sizeof(slot));
+
+        size_t mask = idx->cap - 1;
+        for (size_t i = 0; i < old_cap; ++i) {
+                if (!old[i].key) continue;
+                size_t j = hash(old[i].key) & mask;
+                while (idx->slots[j].key) j = (j + 1) & mask;
+                idx->slots[j] = old[i];
+        }
+        free(old);
+}
+
+static slot *
+insert(trigram_index *idx,
+       uint32_t tri)
+{
+        if ((idx->len + 1) * 2 > idx->cap) {
+                grow(idx);
+        }
+
+        uint32_t key = tri + 1;
+        size_t mask = idx->cap - 1;
+        size_t i = hash(key) & mask;
+        for (; idx->slots[i].key; i = (i + 1) & mask) {
+                if (idx->slots[i].key == key) return &idx->slots[i];
+        }
+
+        idx->slots[i].key = key;
+        idx->len++;
+        return &idx->slots[i];
+}
+
+static void
+add_string(trigram_index *idx,
+           uint32_t id,
+           const char *s)
+{
+        if (!s) return;
+        size_t n = strlen(s);
+        for (size_t i = 0; i + 3 <= n; ++i) {
+                slot *sl = insert(idx, trigram_of(s + i));
+                // Ids are added in increasing order, so the lists
+                // stay sorted and a repeat can only be the last one.
+                if (sl->postings.len && sl->postings.data[sl->postings.len-1] == id) {
+                        continue;
+                }
+                dyn_array_append(sl->postings, id);
+        }
+}
+
+void
+trigram_rebuild(trigram_index *idx,
+                const proc_ptr_array *procs)
+{
+        // Keep the slots and their allocations around, a refresh
+        // mostly sees the same trigrams again.
+        for (size_t i = 0; i < idx->cap; ++i) {
+                idx->slots[i].postings.len = 0;
+        }
+
+        for (size_t i = 0; i < procs->len; ++i) {
+                const proc *p = procs->data[i];
+                add_string(idx, (uint32_t)i, p->cmd);
+                add_string(idx, (uint32_t)i, p->user);
+                add_string(idx, (uint32_t)i, p->pidstr);
+                add_string(idx, (uint32_t)i, p->args);
+        }
+}
+
+trigram_index *
+trigram_build(const proc_ptr_array *procs)
+{
+        trigram_index *idx = calloc(1, sizeof(*idx));
+        if (!idx) return NULL;
+        grow(idx);
+        trigram_rebuild(idx, procs);
+        return idx;
+}
+
+static int
+postings_cmp(const void *a,
+             const void *b)
+{
+        const u32_array *pa = *(const u32_array **)a, *pb = *(const u32_array **)b;
+        return pa->len < pb->len ? -1 : pa->len > pb->len;
+}
+
+int
+trigram_candidates(const trigram_index *idx,
+                   const char *lit,
+                   u32_array *out)
+{
+        size_t n = strlen(lit);
+        if (n < 3) return 0;
+
+        size_t ntri = n - 2;
+        const u32_array **lists = malloc(ntri * sizeof(*lists));
+        if (!lists) return 0;
+
+        out->len = 0;
+        for (size_t i = 0; i < ntri; ++i) {
+                const slot *sl = lookup(idx, trigram_of(lit + i));
+                if (!sl || sl->postings.len == 0) {
+                        free(lists);
+                        return 1;
+                }
+                lists[i] = &sl->postings;
+        }
+
+        // Intersect starting from the shortest list.
+        qsort(lists, ntri, sizeof(*lists), postings_cmp);
+
+        for (size_t i = 0; i < lists[0]->len; ++i) {
+                dyn_array_append(*out, lists[0]->data[i]);
+        }
+
+        for (size_t l = 1; l < ntri && out->len; ++l) {
+                const u32_array *b = lists[l];
+                size_t w = 0, j = 0;
+                for (size_t i = 0; i < out->len && j < b->len; ) {
+                        if (out->data[i] < b->data[j]) ++i;
+                        else if (out->data[i] > b->data[j]) ++j;
+                        else out->data[w++] = out->data[i], ++i, ++j;
+                }
+                out->len = w;
+        }
+
+        free(lists);
+        return 1;
+}
+
+void
+trigram_free(trigram_index *idx)
+{
+        if (!idx) return;
+        for (size_t i = 0; i < idx->cap; ++i) {
+                dyn_array_free(idx->slots[i].postings);
+        }
+        free(idx->slots);
+        free(idx);
+}
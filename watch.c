@@ -0,0 +1,515 @@
+/*
+ * xkillr: Kill processes
+ * Copyright (C) 2025  malloc-nbytes
+ * Contact: zdhdev@yahoo.com
+
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "watch.h"
+#include "proc.h"
+#include "query.h"
+#include "intern.h"
+
+// How often to rescan, whatever the rules ask for.
+#define MIN_TICK_MS 250
+#define PORT_RESOLVE_MS 10000 // even without new or gone processes
+#define MAX_TICK_MS 60000
+
+typedef struct {
+        char name[64];
+        query *q;
+        int is_static;
+        uint64_t age_ms; // 0: any age
+        double cpu;      // < 0: any usage
+        uint64_t for_ms;
+        int sig;
+} rule;
+
+DYN_ARRAY_TYPE(rule, rule_array);
+
+typedef struct {
+        uint64_t since; // when the rule started holding, 0 if it does not
+        int8_t match;   // cached query result for static rules, -1 if unknown
+        uint8_t fired;
+} rule_state;
+
+// What is remembered about a process between scans.
+typedef struct {
+        pid_t pid;
+        uint64_t start;    // tells a reused pid apart
+        uint64_t cmd_hash; // changes when it execs
+        uint64_t ticks;    // utime + stime at the last scan
+        rule_state *rules;
+} watched;
+
+DYN_ARRAY_TYPE(watched, watched_array);
+
+static volatile sig_atomic_t stop = 0;
+
+static void
+on_signal(int sig)
+{
+        (void)sig;
+        stop = 1;
+}
+
+static const struct {
+        const char *name;
+        int sig;
+} signals[] = {
+        {"HUP",  SIGHUP},
+        {"INT",  SIGINT},
+        {"QUIT", SIGQUIT},
+        {"KILL", SIGKILL},
+        {"USR1", SIGUSR1},
+        {"USR2", SIGUSR2},
+        {"TERM", SIGTERM},
+        {"CONT", SIGCONT},
+        {"STOP", SIGSTOP},
+};
+
+#define SIGNALS_LEN (sizeof(signals)/sizeof(*signals))
+
+int
+watch_parse_signal(const char *s)
+{
+        if (!strncmp(s, "SIG", 3)) s += 3;
+        for (size_t i = 0; i < SIGNALS_LEN; ++i) {
+                if (!strcmp(s, signals[i].name)) return signals[i].sig;
+        }
+
+        char *end;
+        long n = strtol(s, &end, 10);
+        if (*s && !*end && n > 0 && n < NSIG) return (int)n;
+        return -1;
+}
+
+void
+watch_signal_name(char *buf,
+                  size_t n,
+                  int sig)
+{
+        for (size_t i = 0; i < SIGNALS_LEN; ++i) {
+                if (signals[i].sig == sig) {
+                        snprintf(buf, n, "SIG%s", signals[i].name);
+                        return;
+                }
+        }
+        snprintf(buf, n, "signal %d", sig);
+}
+
+// Ns, Nm, Nh or Nd, seconds by default.
+static int
+parse_duration(const char *s,
+               uint64_t *ms)
+{
+        char *end;
+        unsigned long long n = strtoull(s, &end, 10);
+        if (end == s) return 0;
+
+        uint64_t unit = 1000;
+        if (*end == 's') ++end;
+        else if (*end == 'm') unit = 60 * 1000, ++end;
+        else if (*end == 'h') unit = 3600 * 1000, ++end;
+        else if (*end == 'd') unit = 86400 * 1000, ++end;
+        if (*end) return 0;
+
+        *ms = n * unit;
+        return 1;
+}
+
+static uint64_t
+now_ms(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint64_t
+hash_str(const char *s)
+{
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (; s && *s; ++s) {
+                h ^= (unsigned char)*s;
+                h *= 0x100000001b3ull;
+        }
+        return h;
+}
+
+// Returns NULL on success, or what is wrong with the line.
+static const char *
+parse_rule(char *line,
+           unsigned lineno,
+           rule *r)
+{
+        memset(r, 0, sizeof(*r));
+        r->cpu = -1;
+        snprintf(r->name, sizeof(r->name), "line %u", lineno);
+
+        char *arrow = strstr(line, "->");
+        if (!arrow) return "expected `-> SIGNAL`";
+        *arrow = '\0';
+
+        char *sig = arrow + 2;
+        while (isspace((unsigned char)*sig)) ++sig;
+        char *end = sig + strlen(sig);
+        while (end > sig && isspace((unsigned char)end[-1])) *--end = '\0';
+        if ((r->sig = watch_parse_signal(sig)) == -1) return "unknown signal";
+
+        char terms[1024];
+        size_t len = 0;
+        int first = 1;
+        for (char *tok = strtok(line, " \t"); tok; tok = strtok(NULL, " \t"), first = 0) {
+                size_t n = strlen(tok);
+                if (first && n > 1 && tok[n-1] == ':' && !memchr(tok, ':', n - 1)) {
+                        snprintf(r->name, sizeof(r->name), "%.*s", (int)(n - 1), tok);
+                } else if (!strncmp(tok, "age>", 4)) {
+                        if (!parse_duration(tok + 4, &r->age_ms)) return "bad age";
+                } else if (!strncmp(tok, "cpu>", 4)) {
+                        char *e;
+                        r->cpu = strtod(tok + 4, &e);
+                        if (e == tok + 4 || (*e && strcmp(e, "%"))) return "bad cpu percentage";
+                } else if (!strcmp(tok, "for")) {
+                        char *d = strtok(NULL, " \t");
+                        if (!d || !parse_duration(d, &r->for_ms)) return "bad duration after `for`";
+                } else {
+                        if (len + n + 1 >= sizeof(terms)) return "too many search terms";
+                        if (len) terms[len++] = ' ';
+                        memcpy(terms + len, tok, n);
+                        len += n;
+                }
+        }
+
+        // Without terms a rule would match every process.
+        if (len == 0) return "no search terms";
+        if (!(r->q = query_compile_strict(terms, len))) return "bad search terms";
+        r->is_static = query_is_static(r->q);
+        return NULL;
+}
+
+static int
+load_rules(const char *path,
+           rule_array *rules)
+{
+        FILE *f = fopen(path, "r");
+        if (!f) {
+                perror(path);
+                return -1;
+        }
+
+        char line[1024];
+        unsigned lineno = 0;
+        int res = 0;
+        while (fgets(line, sizeof(line), f)) {
+                ++lineno;
+                char *hash = strchr(line, '#');
+                if (hash) *hash = '\0';
+
+                char *s = line;
+                while (isspace((unsigned char)*s)) ++s;
+                if (!*s) continue;
+
+                rule r;
+                const char *err = parse_rule(s, lineno, &r);
+                if (err) {
+                        fprintf(stderr, "%s:%u: %s\n", path, lineno, err);
+                        query_free(r.q);
+                        res = -1;
+                        continue;
+                }
+                dyn_array_append(*rules, r);
+        }
+        fclose(f);
+
+        if (res == 0 && rules->len == 0) {
+                fprintf(stderr, "%s: no rules\n", path);
+                res = -1;
+        }
+        return res;
+}
+
+// Scan often enough to honour the shortest `for`, and to catch
+// processes soon after they cross an age.
+static uint64_t
+tick_ms(const rule_array *rules)
+{
+        uint64_t tick = MAX_TICK_MS;
+        for (size_t i = 0; i < rules->len; ++i) {
+                const rule *r = &rules->data[i];
+                uint64_t t = 1000;
+                if (r->for_ms) t = r->for_ms / 4;
+                else if (r->age_ms && r->cpu < 0) t = r->age_ms / 60;
+                if (t < tick) tick = t;
+        }
+        if (tick < MIN_TICK_MS) tick = MIN_TICK_MS;
+        return tick;
+}
+
+static void
+log_action(const rule *r,
+           const proc *p,
+           double cpu,
+           uint64_t age_ms,
+           const char *verb,
+           const char *err)
+{
+        char when[32], sig[16];
+        time_t t = time(NULL);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+        watch_signal_name(sig, sizeof(sig), r->sig);
+
+        uint64_t age = age_ms / 1000;
+        fprintf(stderr, "%s %s: %s %s to %s %s (user %s, age %lluh%02llum%02llus, cpu %.1f%%, rss %.1fM)%s%s\n",
+                when, r->name, verb, sig, p->pidstr, p->cmd, p->user,
+                (unsigned long long)(age / 3600), (unsigned long long)(age / 60 % 60),
+                (unsigned long long)(age % 60), cpu, (double)p->rss / (1024 * 1024),
+                err ? ": " : "", err ? err : "");
+}
+
+// Signals `p` only if it is still the process that was scanned,
+// not another one that got its pid since.
+static int
+send_signal(const proc *p,
+            int sig)
+{
+        int pidfd = -1;
+#ifdef SYS_pidfd_open
+        pidfd = (int)syscall(SYS_pidfd_open, p->pid, 0);
+        if (pidfd == -1 && errno != ENOSYS) return -1;
+#endif
+
+        // With a pidfd, the check below and the signal are
+        // about the same process.
+        proc *now = proc_get(p->pid, PF_STAT);
+        int same = now && now->start == p->start;
+        proc_free(now);
+
+        int res = -1;
+        if (!same) {
+                errno = ESRCH;
+        } else if (pidfd != -1) {
+#ifdef SYS_pidfd_send_signal
+                res = (int)syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+#endif
+        } else {
+                res = kill(p->pid, sig);
+        }
+
+        if (pidfd != -1) {
+                int err = errno;
+                close(pidfd);
+                errno = err;
+        }
+        return res;
+}
+
+static int
+pid_cmp(const void *a,
+        const void *b)
+{
+        const proc *pa = *(const proc **)a, *pb = *(const proc **)b;
+        return (pa->pid > pb->pid) - (pa->pid < pb->pid);
+}
+
+static void
+check_rules(const rule_array *rules,
+            watched *w,
+            proc *p,
+            double cpu,
+            uint64_t age_ms,
+            uint64_t now,
+            int dry_run)
+{
+        for (size_t i = 0; i < rules->len; ++i) {
+                const rule *r = &rules->data[i];
+                rule_state *st = &w->rules[i];
+                if (st->fired) continue;
+
+                // The cheap conditions first, then the (cached) query.
+                int holds = (!r->age_ms || age_ms > r->age_ms) && (r->cpu < 0 || cpu > r->cpu);
+                if (holds) {
+                        if (r->is_static && st->match != -1) {
+                                holds = st->match;
+                        } else {
+                                holds = query_match(r->q, p);
+                                if (r->is_static) st->match = (int8_t)holds;
+                        }
+                }
+
+                if (!holds) {
+                        st->since = 0;
+                        continue;
+                }
+                if (!st->since) st->since = now;
+                if (now - st->since < r->for_ms) continue;
+
+                st->fired = 1;
+                if (dry_run) {
+                        log_action(r, p, cpu, age_ms, "would send", NULL);
+                } else if (send_signal(p, r->sig) == -1) {
+                        log_action(r, p, cpu, age_ms, "failed to send", strerror(errno));
+                } else {
+                        log_action(r, p, cpu, age_ms, "sent", NULL);
+                }
+        }
+}
+
+// Whether the scan has other processes than `seen`, both sorted
+// by pid
+static int
+pids_changed(const proc_ptr_array *procs,
+             const watched_array *seen)
+{
+        if (procs->len != seen->len) return 1;
+        for (size_t i = 0; i < procs->len; ++i) {
+                if (procs->data[i]->pid != seen->data[i].pid
+                    || procs->data[i]->start != seen->data[i].start) return 1;
+        }
+        return 0;
+}
+
+// One scan. `seen` is sorted by pid and replaced by the
+// processes of this scan.
+static void
+tick(const rule_array *rules,
+     watched_array *seen,
+     uint64_t *last,
+     int dry_run)
+{
+        proc_ptr_array procs = dyn_array_empty(proc_ptr_array);
+        watched_array next = dyn_array_empty(watched_array);
+
+        uint64_t now = now_ms();
+        double dt = *last ? (double)(now - *last) / 1000.0 : 0.0;
+        *last = now;
+        double uptime = proc_uptime(), hz = proc_hz();
+
+        if (proc_scan(&procs, PF_DEFAULT | PF_STAT) == 0 && procs.len > 1) {
+                qsort(procs.data, procs.len, sizeof(proc *), pid_cmp);
+        }
+
+        // Owners of a port as of this scan, not of startup. That
+        // reads every fd of every process, so only when processes
+        // came or went, or a socket may have changed hands since.
+        static uint64_t ports_ms = 0;
+        if (pids_changed(&procs, seen) || now - ports_ms >= PORT_RESOLVE_MS) {
+                int resolved = 0;
+                for (size_t i = 0; i < rules->len; ++i) {
+                        if (!query_uses_port(rules->data[i].q)) continue;
+                        query_resolve_ports(rules->data[i].q);
+                        resolved = 1;
+                }
+                if (resolved) ports_ms = now;
+        }
+
+        size_t j = 0;
+        for (size_t i = 0; i < procs.len; ++i) {
+                proc *p = procs.data[i];
+                uint64_t ticks = p->utime + p->stime;
+                double started = (double)p->start / hz;
+                double age = uptime > started ? uptime - started : 0.0;
+
+                while (j < seen->len && seen->data[j].pid < p->pid) {
+                        free(seen->data[j++].rules);
+                }
+
+                watched w;
+                double cpu;
+                if (j < seen->len && seen->data[j].pid == p->pid && seen->data[j].start == p->start) {
+                        w = seen->data[j++];
+                        cpu = dt > 0 ? 100.0 * ((double)(ticks - w.ticks) / hz) / dt : 0.0;
+                } else {
+                        // New (or a new process under an old pid)
+                        w = (watched) { .pid = p->pid, .start = p->start };
+                        w.rules = malloc(rules->len * sizeof(rule_state));
+                        for (size_t k = 0; k < rules->len; ++k) {
+                                w.rules[k] = (rule_state) { .match = -1 };
+                        }
+                        cpu = age > 0 ? 100.0 * ((double)ticks / hz) / age : 0.0;
+                }
+                w.ticks = ticks;
+
+                uint64_t h = hash_str(p->cmd);
+                if (h != w.cmd_hash) {
+                        for (size_t k = 0; k < rules->len; ++k) w.rules[k].match = -1;
+                        w.cmd_hash = h;
+                }
+
+                check_rules(rules, &w, p, cpu, (uint64_t)(age * 1000), now, dry_run);
+                dyn_array_append(next, w);
+                proc_free(p);
+        }
+
+        while (j < seen->len) {
+                free(seen->data[j++].rules);
+        }
+        dyn_array_free(*seen);
+        *seen = next;
+        dyn_array_free(procs);
+        // Rules and `seen` keep no interned strings
+        intern_trim(INTERN_TRIM);
+}
+
+int
+watch_run(const char *rules_path,
+          int dry_run)
+{
+        rule_array rules = dyn_array_empty(rule_array);
+        if (load_rules(rules_path, &rules) == -1) {
+                for (size_t i = 0; i < rules.len; ++i) query_free(rules.data[i].q);
+                dyn_array_free(rules);
+                return -1;
+        }
+
+        struct sigaction sa = {0};
+        sa.sa_handler = on_signal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        uint64_t interval = tick_ms(&rules);
+        fprintf(stderr, "watching %zu rule%s from %s, scanning every %llums%s\n",
+                rules.len, rules.len == 1 ? "" : "s", rules_path,
+                (unsigned long long)interval, dry_run ? " (dry run)" : "");
+
+        watched_array seen = dyn_array_empty(watched_array);
+        uint64_t last = 0;
+        while (!stop) {
+                tick(&rules, &seen, &last, dry_run);
+                uint64_t spent = now_ms() - last;
+                if (spent < interval) {
+                        poll(NULL, 0, (int)(interval - spent));
+                }
+        }
+
+        for (size_t i = 0; i < seen.len; ++i) free(seen.data[i].rules);
+        dyn_array_free(seen);
+        for (size_t i = 0; i < rules.len; ++i) query_free(rules.data[i].q);
+        dyn_array_free(rules);
+        return 0;
+}